@@ -0,0 +1,269 @@
+#ifndef APTDB_H
+#define APTDB_H
+
+#include <QByteArray>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QMutex>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <QtConcurrent>
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "updaterecord.h"
+#include "vercmp.h"
+
+namespace Scan {
+
+// Position of the first `c` in [p, end), or end. Looks at 16 bytes per
+// step where SSE2 is available.
+inline const char *findByte(const char *p, const char *end, char c) {
+#if defined(__SSE2__)
+    const __m128i needle = _mm_set1_epi8(c);
+    while (end - p >= 16) {
+        __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+        int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(block, needle));
+        if (mask) return p + __builtin_ctz(unsigned(mask));
+        p += 16;
+    }
+#endif
+    const void *hit = std::memchr(p, c, std::size_t(end - p));
+    return hit ? static_cast<const char *>(hit) : end;
+}
+
+// Walks the stanzas of a deb822 file (dpkg status, apt Packages lists) and
+// reports the fields named in `wanted` for each one. Continuation lines and
+// every other field are skipped without being looked at.
+template <std::size_t N, typename F>
+void stanzas(std::string_view data, const std::string_view (&wanted)[N], F &&onStanza) {
+    std::string_view values[N];
+    bool any = false;
+
+    const char *p = data.data();
+    const char *end = p + data.size();
+    while (p < end) {
+        const char *eol = findByte(p, end, '\n');
+        std::string_view line(p, std::size_t(eol - p));
+        p = eol + (eol < end ? 1 : 0);
+
+        if (line.empty()) {
+            if (any) onStanza(values);
+            std::fill(std::begin(values), std::end(values), std::string_view());
+            any = false;
+            continue;
+        }
+        if (line.front() == ' ' || line.front() == '\t') continue;
+
+        for (std::size_t i = 0; i < N; ++i) {
+            const std::string_view &key = wanted[i];
+            if (line.size() > key.size() && line[key.size()] == ':' && line.substr(0, key.size()) == key) {
+                std::string_view value = line.substr(key.size() + 1);
+                while (!value.empty() && value.front() == ' ') value.remove_prefix(1);
+                values[i] = value;
+                any = true;
+                break;
+            }
+        }
+    }
+    if (any) onStanza(values);
+}
+
+} // namespace Scan
+
+// apt list --upgradable without apt: the installed packages from the dpkg
+// status file are compared with the newest version found in the downloaded
+// Packages lists. Files are memory mapped and lists are scanned in
+// parallel. Pin priorities are not evaluated; lists from NotAutomatic
+// releases such as backports are skipped, which matches the default policy
+// for everything not installed from them.
+class AptNativeCheck {
+public:
+    AptNativeCheck(const QString &statusPath = "/var/lib/dpkg/status", const QString &listsDir = "/var/lib/apt/lists")
+        : statusPath(statusPath), listsDir(listsDir) {}
+
+    UpdateList run(QByteArray &error) {
+        QMutexLocker locker(&mutex);
+
+        QFile status(statusPath);
+        std::string_view statusData;
+        if (!mapFile(status, statusData)) {
+            error = "Cannot read " + QFile::encodeName(statusPath);
+            return UpdateList();
+        }
+
+        Installed installed;
+        static constexpr std::string_view statusFields[] = { "Package", "Status", "Architecture", "Version" };
+        Scan::stanzas(statusData, statusFields, [&installed](const std::string_view (&v)[4]) {
+            if (v[0].empty() || v[3].empty() || !v[1].ends_with(" installed")) return;
+            installed.emplace(Key{ v[0], v[2] }, Package{ v[3], {}, {} });
+        });
+
+        std::vector<List> lists = findLists();
+        if (lists.empty()) {
+            error = "No uncompressed package lists in " + QFile::encodeName(listsDir);
+            return UpdateList();
+        }
+
+        QtConcurrent::blockingMap(lists, [&installed](List &list) {
+            if (!mapFile(*list.file, list.data)) return;
+
+            static constexpr std::string_view fields[] = { "Package", "Architecture", "Version" };
+            Scan::stanzas(list.data, fields, [&](const std::string_view (&v)[3]) {
+                if (v[0].empty() || v[2].empty()) return;
+                Key key{ v[0], v[1] };
+                if (installed.find(key) == installed.end()) return;
+
+                // Lists often carry several versions of a package; the best
+                // one so far is kept pre-split for the next comparison
+                Vercmp::DpkgVersion version(v[2]);
+                auto best = list.candidates.find(key);
+                if (best == list.candidates.end()) {
+                    list.candidates.emplace(key, version);
+                } else if (Vercmp::dpkg(version, best->second) > 0) {
+                    best->second = version;
+                }
+            });
+        });
+
+        // Merge the per-list candidates, keeping the newest version
+        for (const List &list : lists) {
+            for (const auto &[key, version] : list.candidates) {
+                Package &package = installed.find(key)->second;
+                if (package.candidate.empty() || Vercmp::dpkg(version.full, package.candidate) > 0) {
+                    package.candidate = version.full;
+                    package.suite = std::string_view(list.suite.constData(), list.suite.size());
+                }
+            }
+        }
+
+        struct Pending {
+            const Key *key;
+            const Package *package;
+        };
+        QVector<Pending> pending;
+        for (const auto &[key, package] : installed) {
+            if (!package.candidate.empty() && Vercmp::dpkg(package.candidate, package.version) > 0) {
+                pending.append(Pending{ &key, &package });
+            }
+        }
+        std::sort(pending.begin(), pending.end(), [](const Pending &a, const Pending &b) {
+            return a.key->name < b.key->name;
+        });
+
+        // Copy the few strings that matter out of the mappings before they close
+        UpdateList list;
+        list.records.reserve(pending.size());
+        for (const Pending &p : pending) {
+            list.append(bytes(p.key->name), bytes(p.package->version), bytes(p.package->candidate),
+                        bytes(p.package->suite), bytes(p.key->arch));
+        }
+        return list;
+    }
+
+private:
+    struct Key {
+        std::string_view name;
+        std::string_view arch;
+        bool operator==(const Key &other) const { return name == other.name && arch == other.arch; }
+    };
+
+    struct KeyHash {
+        std::size_t operator()(const Key &key) const {
+            std::hash<std::string_view> hash;
+            return hash(key.name) * 31 + hash(key.arch);
+        }
+    };
+
+    struct Package {
+        std::string_view version;
+        std::string_view candidate;
+        std::string_view suite;
+    };
+
+    using Installed = std::unordered_map<Key, Package, KeyHash>;
+
+    struct List {
+        std::unique_ptr<QFile> file;    // keeps the mapping alive
+        QByteArray suite;
+        std::string_view data;
+        std::unordered_map<Key, Vercmp::DpkgVersion, KeyHash> candidates;
+    };
+
+    static QByteArray bytes(std::string_view s) { return QByteArray(s.data(), qsizetype(s.size())); }
+
+    static bool mapFile(QFile &file, std::string_view &data) {
+        if (!file.open(QIODevice::ReadOnly)) return false;
+        if (file.size() == 0) {
+            data = {};
+            return true;
+        }
+        uchar *mapped = file.map(0, file.size());
+        if (!mapped) return false;
+        data = std::string_view(reinterpret_cast<const char *>(mapped), std::size_t(file.size()));
+        return true;
+    }
+
+    std::vector<List> findLists() const {
+        std::vector<List> lists;
+        QDir dir(listsDir);
+        const QStringList names = dir.entryList({ "*_Packages" }, QDir::Files);
+        lists.reserve(names.size());
+
+        for (const QString &name : names) {
+            QByteArray suite;
+            if (!releaseAllowsUpgrades(dir, name, suite)) continue;
+
+            List list;
+            list.file = std::make_unique<QFile>(dir.filePath(name));
+            list.suite = suite;
+            lists.push_back(std::move(list));
+        }
+        return lists;
+    }
+
+    // Finds the Release file a list belongs to by dropping trailing name
+    // components and reads its suite. NotAutomatic releases are rejected
+    // outright, so packages installed from backports are not offered
+    // their backports upgrades.
+    static bool releaseAllowsUpgrades(const QDir &dir, const QString &listName, QByteArray &suite) {
+        QString prefix = listName;
+        int cut;
+        while ((cut = prefix.lastIndexOf('_')) > 0) {
+            prefix = prefix.left(cut);
+            for (const char *releaseName : { "_InRelease", "_Release" }) {
+                QFile release(dir.filePath(prefix + releaseName));
+                if (!release.open(QIODevice::ReadOnly)) continue;
+
+                // The header fields come before the checksum lists
+                bool notAutomatic = false;
+                while (!release.atEnd()) {
+                    QByteArray line = release.readLine().trimmed();
+                    if (line.startsWith("MD5Sum:") || line.startsWith("SHA1:") || line.startsWith("SHA256:") ||
+                        line.startsWith("-----BEGIN PGP SIGNATURE")) break;
+                    if (line.startsWith("Suite:")) suite = line.mid(6).trimmed();
+                    else if (line.startsWith("NotAutomatic:")) notAutomatic = line.mid(13).trimmed() == "yes";
+                }
+                return !notAutomatic;
+            }
+        }
+        return true;
+    }
+
+    QMutex mutex;
+    QString statusPath;
+    QString listsDir;
+};
+
+#endif // APTDB_H
@@ -0,0 +1,409 @@
+#ifndef BACKEND_H
+#define BACKEND_H
+
+#include <QByteArray>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QList>
+#include <QString>
+#include <QStringList>
+
+#include <concepts>
+#include <memory>
+#include <utility>
+#include <variant>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/sysmacros.h>
+#include <unistd.h>
+
+#include "aptdb.h"
+#include "installprogress.h"
+#include "pacmansync.h"
+#include "prefetch.h"
+#include "updaterecord.h"
+
+// Key/value view of /etc/os-release, read once at startup
+class OsRelease {
+public:
+    static OsRelease load() {
+        OsRelease os;
+        QFile file("/etc/os-release");
+        if (!file.open(QIODevice::ReadOnly)) {
+            file.setFileName("/usr/lib/os-release");
+            if (!file.open(QIODevice::ReadOnly)) return os;
+        }
+        os.parse(file.readAll());
+        return os;
+    }
+
+    void parse(const QByteArray &content) {
+        for (const QByteArray &rawLine : content.split('\n')) {
+            QByteArray line = rawLine.trimmed();
+            if (line.isEmpty() || line.startsWith('#')) continue;
+
+            int eq = line.indexOf('=');
+            if (eq <= 0) continue;
+            fields.insert(QString::fromUtf8(line.left(eq)), unquote(line.mid(eq + 1)));
+        }
+        id = value("ID").toLower();
+        idLike = value("ID_LIKE").toLower().split(' ', Qt::SkipEmptyParts);
+    }
+
+    QString value(const QString &key) const { return fields.value(key); }
+
+    // True if the system is `name` or declares itself derived from it
+    bool is(const QString &name) const { return id == name || idLike.contains(name); }
+
+    QString id;
+    QStringList idLike;
+
+private:
+    static QString unquote(const QByteArray &value) {
+        if (value.size() < 2 || (value.front() != '"' && value.front() != '\'') || value.back() != value.front()) {
+            return QString::fromUtf8(value);
+        }
+
+        QByteArray inner = value.mid(1, value.size() - 2);
+        if (value.front() == '"') {
+            QByteArray unescaped;
+            for (int i = 0; i < inner.size(); ++i) {
+                if (inner.at(i) == '\\' && i + 1 < inner.size()) ++i;
+                unescaped += inner.at(i);
+            }
+            inner = unescaped;
+        }
+        return QString::fromUtf8(inner);
+    }
+
+    QHash<QString, QString> fields;
+};
+
+struct BackendCommand {
+    QString program;
+    QStringList args;
+};
+
+// True if another process holds a lock on `path`, the way apt and dpkg
+// guard their databases. Their lock files are root's and 0640, so the
+// locks are looked up in /proc/locks by inode rather than probed through
+// the file. On btrfs stat() reports an anonymous device for the subvolume
+// while /proc/locks has the filesystem's, so there the inode alone has to
+// do; a mistaken match only delays a check. When no lock table is available the
+// file is probed, and a file that cannot be probed counts as locked; the
+// scheduler runs the check anyway after its last retry.
+inline bool isFileLockHeld(const char *path) {
+    struct stat st;
+    if (::stat(path, &st) != 0) return false;   // no lock file, no lock
+
+    QFile locks("/proc/locks");
+    if (locks.open(QIODevice::ReadOnly)) {
+        // "1: POSIX  ADVISORY  WRITE 1234 fd:01:131090 0 EOF"; waiters
+        // blocked on a lock are listed as "1: -> POSIX ..." after it
+        for (const QByteArray &line : locks.readAll().split('\n')) {
+            QList<QByteArray> fields = line.simplified().split(' ');
+            if (fields.size() < 6 || fields.at(1) == "->") continue;
+            QList<QByteArray> id = fields.at(5).split(':');
+            if (id.size() != 3 || id.at(2).toULongLong() != quint64(st.st_ino)) continue;
+            bool sameDevice = id.at(0).toUInt(nullptr, 16) == major(st.st_dev) &&
+                              id.at(1).toUInt(nullptr, 16) == minor(st.st_dev);
+            if (sameDevice || major(st.st_dev) == 0) return true;
+        }
+        return false;
+    }
+
+    int fd = ::open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return true;
+
+    struct flock lock = {};
+    lock.l_type = F_WRLCK;
+    lock.l_whence = SEEK_SET;
+    bool held = ::fcntl(fd, F_GETLK, &lock) == 0 && lock.l_type != F_UNLCK;
+    ::close(fd);
+    return held;
+}
+
+// True if a process whose command name is `name` is running
+inline bool isProcessRunning(const QByteArray &name) {
+    const QStringList pids = QDir("/proc").entryList(QDir::Dirs | QDir::NoDotAndDotDot);
+    for (const QString &pid : pids) {
+        if (!pid.front().isDigit()) continue;
+        QFile comm("/proc/" + pid + "/comm");
+        if (comm.open(QIODevice::ReadOnly) && comm.readAll().trimmed() == name) return true;
+    }
+    return false;
+}
+
+// Arch Linux and derivatives (CachyOS, Manjaro, EndeavourOS)
+class PacmanBackend {
+public:
+    static bool matches(const OsRelease &os) { return os.is("arch"); }
+
+    QString name() const { return "pacman"; }
+    BackendCommand checkCommand() const { return { "checkupdates", {} }; }
+    UpdateFormat format() const { return UpdateFormat::Checkupdates; }
+    QByteArray filterError(const QByteArray &error) const { return error; }
+    BackendCommand installCommand() const {
+        QString copy = copyStaged();
+        if (copy.isEmpty()) return { "konsole", { "-e", "sudo", "pacman", "-Syu" } };
+        return { "konsole", { "-e", "sudo", "sh", "-c", copy + "exec pacman -Syu" } };
+    }
+
+    // Without a terminal; pkexec clears the environment, so the locale for
+    // the messages that are parsed is set explicitly
+    BackendCommand trayInstallCommand() const {
+        return { "pkexec", { "sh", "-c", copyStaged() + "exec env LC_ALL=C pacman -Syu --noconfirm --noprogressbar" } };
+    }
+    InstallFormat installFormat() const { return InstallFormat::Pacman; }
+
+    // Downloads what -Su would install using the databases checkupdates
+    // synced, under fakeroot like checkupdates itself
+    BackendCommand prefetchCommand(const PrefetchOptions &options) const {
+        if (options.pacmanDbPath.isEmpty() || !QDir().mkpath(options.stagingDir)) return {};
+        QString conf = options.stagingDir + ".pacman.conf";
+        if (!Prefetch::writePacmanConf(options.pacmanConf, conf, options.rateLimitKb)) return {};
+        return { "fakeroot", { "--", "pacman", "-Suw", "--noconfirm", "--noprogressbar", "--config", conf,
+                               "--dbpath", options.pacmanDbPath, "--cachedir", options.stagingDir,
+                               "--logfile", "/dev/null" } };
+    }
+
+    // name-version-arch.pkg.tar.*
+    QByteArray stagedPrefix(const QByteArray &name, const QByteArray &version) const {
+        return name + '-' + version + '-';
+    }
+    QString lockFile() const { return "/var/lib/pacman/db.lck"; }
+    QStringList watchPaths() const { return { "/var/lib/pacman/sync", "/var/lib/pacman/local" }; }
+
+    // pacman holds its lock by creating db.lck and removing it when done.
+    // A crash or power loss leaves the file behind, so it only counts while
+    // a pacman process runs and for at most StaleLockSec.
+    bool isLocked() const { return QFile::exists(lockFile()) && !hasStaleLock(); }
+    bool hasStaleLock() const {
+        QFileInfo lock(lockFile());
+        if (!lock.exists()) return false;
+        return lock.lastModified().secsTo(QDateTime::currentDateTime()) > StaleLockSec || !isProcessRunning("pacman");
+    }
+
+    bool hasNativeCheck() const { return true; }
+    UpdateList nativeCheck(QByteArray &error) const { return native->run(error); }
+
+private:
+    static constexpr int StaleLockSec = 60 * 60;
+
+    // Packages and their detached signatures
+    QString copyStaged() const {
+        return Prefetch::copyStagedCommand(name(), "*.pkg.tar*", "/var/cache/pacman/pkg");
+    }
+
+    // Shared so that copies of the backend reuse the cached databases
+    std::shared_ptr<PacmanNativeCheck> native = std::make_shared<PacmanNativeCheck>();
+};
+
+// KDE neon goes through PackageKit rather than apt directly
+class PkconBackend {
+public:
+    static bool matches(const OsRelease &os) { return os.id == "neon"; }
+
+    QString name() const { return "pkcon"; }
+    BackendCommand checkCommand() const { return { "pkcon", { "get-updates" } }; }
+    UpdateFormat format() const { return UpdateFormat::Pkcon; }
+    QByteArray filterError(const QByteArray &error) const { return error; }
+    BackendCommand installCommand() const { return { "konsole", { "-e", "sudo", "pkcon", "update", "-y" } }; }
+
+    // PackageKit asks polkit for authorization itself
+    BackendCommand trayInstallCommand() const { return { "pkcon", { "update", "-y", "--plain" } }; }
+    InstallFormat installFormat() const { return InstallFormat::Pkcon; }
+
+    // PackageKit keeps downloads in its own cache, which is not inspected,
+    // and has no bandwidth limit
+    BackendCommand prefetchCommand(const PrefetchOptions &) const {
+        return { "pkcon", { "update", "--only-download", "-y", "--plain" } };
+    }
+    QByteArray stagedPrefix(const QByteArray &, const QByteArray &) const { return QByteArray(); }
+    QString lockFile() const { return "/var/lib/dpkg/lock-frontend"; }
+    QStringList watchPaths() const { return { "/var/lib/apt/lists", "/var/lib/dpkg/status" }; }
+    bool isLocked() const { return isFileLockHeld("/var/lib/dpkg/lock-frontend"); }
+    bool hasStaleLock() const { return false; }  // fcntl locks go away with their process
+
+    // PackageKit on neon works from the same apt lists
+    bool hasNativeCheck() const { return true; }
+    UpdateList nativeCheck(QByteArray &error) const { return native->run(error); }
+
+private:
+    std::shared_ptr<AptNativeCheck> native = std::make_shared<AptNativeCheck>();
+};
+
+// Debian, Ubuntu and derivatives
+class AptBackend {
+public:
+    static bool matches(const OsRelease &os) { return os.is("debian") || os.is("ubuntu"); }
+
+    QString name() const { return "apt"; }
+    BackendCommand checkCommand() const { return { "apt", { "list", "--upgradable" } }; }
+    UpdateFormat format() const { return UpdateFormat::Apt; }
+
+    // apt warns about its CLI on every run; that is not a failure
+    QByteArray filterError(const QByteArray &error) const {
+        QByteArray filtered;
+        for (const QByteArray &line : error.split('\n')) {
+            if (line.trimmed().isEmpty() || line.startsWith("WARNING: apt does not have a stable CLI interface")) continue;
+            filtered += line + '\n';
+        }
+        return filtered;
+    }
+
+    BackendCommand installCommand() const {
+        return { "konsole", { "-e", "sudo", "sh", "-c", copyStaged() + "apt update && apt upgrade -y" } };
+    }
+
+    // apt-get reports machine readable progress on the status fd; like
+    // apt upgrade it installs new dependencies instead of holding back
+    BackendCommand trayInstallCommand() const {
+        return { "pkexec", { "sh", "-c",
+                             copyStaged() + "apt-get update -q && exec env LC_ALL=C DEBIAN_FRONTEND=noninteractive "
+                             "apt-get upgrade -y --with-new-pkgs -o APT::Status-Fd=1 -o Dpkg::Use-Pty=0 "
+                             "-o Dpkg::Options::=--force-confdef -o Dpkg::Options::=--force-confold" } };
+    }
+    InstallFormat installFormat() const { return InstallFormat::Apt; }
+
+    // Without the dpkg lock apt can download as the user; sources may be
+    // file: URIs like any others
+    BackendCommand prefetchCommand(const PrefetchOptions &options) const {
+        if (!QDir().mkpath(options.stagingDir + "/partial")) return {};
+        QStringList args = { "--download-only", "--with-new-pkgs", "-y", "-q", "-o", "Debug::NoLocking=1",
+                             "-o", "Dir::Cache::Archives=" + options.stagingDir + "/" };
+        if (options.rateLimitKb > 0) args << "-o" << QString("Acquire::http::Dl-Limit=%1").arg(options.rateLimitKb);
+        return { "apt-get", args << "upgrade" };
+    }
+
+    // name_version_arch.deb, with the epoch colon escaped
+    QByteArray stagedPrefix(const QByteArray &name, const QByteArray &version) const {
+        return name + '_' + QByteArray(version).replace(":", "%3a") + '_';
+    }
+    QString lockFile() const { return "/var/lib/dpkg/lock-frontend"; }
+    QStringList watchPaths() const { return { "/var/lib/apt/lists", "/var/lib/dpkg/status" }; }
+    bool isLocked() const { return isFileLockHeld("/var/lib/dpkg/lock-frontend"); }
+    bool hasStaleLock() const { return false; }  // fcntl locks go away with their process
+
+    bool hasNativeCheck() const { return true; }
+    UpdateList nativeCheck(QByteArray &error) const { return native->run(error); }
+
+private:
+    QString copyStaged() const {
+        return Prefetch::copyStagedCommand(name(), "*.deb", "/var/cache/apt/archives");
+    }
+
+    std::shared_ptr<AptNativeCheck> native = std::make_shared<AptNativeCheck>();
+};
+
+// Selected when nothing else matches; every operation is a no-op
+class UnsupportedBackend {
+public:
+    static bool matches(const OsRelease &) { return true; }
+
+    QString name() const { return QString(); }
+    BackendCommand checkCommand() const { return {}; }
+    UpdateFormat format() const { return UpdateFormat::Checkupdates; }
+    QByteArray filterError(const QByteArray &error) const { return error; }
+    BackendCommand installCommand() const { return {}; }
+    BackendCommand trayInstallCommand() const { return {}; }
+    InstallFormat installFormat() const { return InstallFormat::Pacman; }
+    BackendCommand prefetchCommand(const PrefetchOptions &) const { return {}; }
+    QByteArray stagedPrefix(const QByteArray &, const QByteArray &) const { return QByteArray(); }
+    QString lockFile() const { return QString(); }
+    QStringList watchPaths() const { return {}; }
+    bool isLocked() const { return false; }
+    bool hasStaleLock() const { return false; }
+
+    bool hasNativeCheck() const { return false; }
+    UpdateList nativeCheck(QByteArray &) const { return UpdateList(); }
+};
+
+template <typename T>
+concept PackageBackend = requires(const T backend, const OsRelease &os, const QByteArray &error, QByteArray &nativeError,
+                                  const PrefetchOptions &prefetch) {
+    { T::matches(os) } -> std::convertible_to<bool>;
+    { backend.name() } -> std::convertible_to<QString>;
+    { backend.checkCommand() } -> std::convertible_to<BackendCommand>;
+    { backend.format() } -> std::convertible_to<UpdateFormat>;
+    { backend.filterError(error) } -> std::convertible_to<QByteArray>;
+    { backend.installCommand() } -> std::convertible_to<BackendCommand>;
+    { backend.trayInstallCommand() } -> std::convertible_to<BackendCommand>;
+    { backend.installFormat() } -> std::same_as<InstallFormat>;
+    { backend.prefetchCommand(prefetch) } -> std::convertible_to<BackendCommand>;
+    { backend.stagedPrefix(error, error) } -> std::convertible_to<QByteArray>;
+    { backend.lockFile() } -> std::convertible_to<QString>;
+    { backend.watchPaths() } -> std::convertible_to<QStringList>;
+    { backend.isLocked() } -> std::convertible_to<bool>;
+    { backend.hasStaleLock() } -> std::convertible_to<bool>;
+    { backend.hasNativeCheck() } -> std::convertible_to<bool>;
+    { backend.nativeCheck(nativeError) } -> std::convertible_to<UpdateList>;
+};
+
+// The package manager in use, chosen once from os-release. Backends are
+// tried in declaration order, so more specific ones must come first; a new
+// package manager only needs a class above and an entry here.
+class UpdateBackend {
+public:
+    using Variant = std::variant<PkconBackend, PacmanBackend, AptBackend, UnsupportedBackend>;
+
+    static UpdateBackend detect(const OsRelease &os) {
+        UpdateBackend backend;
+        backend.impl = select(os);
+        return backend;
+    }
+
+    bool isSupported() const { return !std::holds_alternative<UnsupportedBackend>(impl); }
+
+    QString name() const { return visit([](const auto &b) { return b.name(); }); }
+    BackendCommand checkCommand() const { return visit([](const auto &b) { return b.checkCommand(); }); }
+    UpdateFormat format() const { return visit([](const auto &b) { return b.format(); }); }
+    QByteArray filterError(const QByteArray &error) const {
+        return visit([&error](const auto &b) { return b.filterError(error); });
+    }
+    BackendCommand installCommand() const { return visit([](const auto &b) { return b.installCommand(); }); }
+    BackendCommand trayInstallCommand() const { return visit([](const auto &b) { return b.trayInstallCommand(); }); }
+    InstallFormat installFormat() const { return visit([](const auto &b) { return b.installFormat(); }); }
+    BackendCommand prefetchCommand(const PrefetchOptions &options) const {
+        return visit([&options](const auto &b) { return b.prefetchCommand(options); });
+    }
+    QByteArray stagedPrefix(const QByteArray &name, const QByteArray &version) const {
+        return visit([&](const auto &b) { return b.stagedPrefix(name, version); });
+    }
+    QString lockFile() const { return visit([](const auto &b) { return b.lockFile(); }); }
+    QStringList watchPaths() const { return visit([](const auto &b) { return b.watchPaths(); }); }
+    bool isLocked() const { return visit([](const auto &b) { return b.isLocked(); }); }
+    // A lock file left behind that isLocked() disregards
+    bool hasStaleLock() const { return visit([](const auto &b) { return b.hasStaleLock(); }); }
+    bool hasNativeCheck() const { return visit([](const auto &b) { return b.hasNativeCheck(); }); }
+
+    // Blocking; meant to run on a worker thread
+    UpdateList nativeCheck(QByteArray &error) const {
+        return visit([&error](const auto &b) { return b.nativeCheck(error); });
+    }
+
+private:
+    template <typename F>
+    auto visit(F &&f) const { return std::visit(std::forward<F>(f), impl); }
+
+    template <std::size_t I = 0>
+    static Variant select(const OsRelease &os) {
+        using Candidate = std::variant_alternative_t<I, Variant>;
+        static_assert(PackageBackend<Candidate>, "backend does not implement the backend interface");
+
+        if constexpr (I + 1 == std::variant_size_v<Variant>) {
+            return Variant(std::in_place_index<I>);
+        } else {
+            if (Candidate::matches(os)) return Variant(std::in_place_index<I>);
+            return select<I + 1>(os);
+        }
+    }
+
+    Variant impl = UnsupportedBackend();
+};
+
+#endif // BACKEND_H
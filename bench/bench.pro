@@ -0,0 +1,20 @@
+# Benchmarks for the update checker internals and a headless run of the
+# check pipeline against fake package manager tools (see --help)
+TARGET = kdeupdater-bench
+
+SOURCES += main.cpp
+
+HEADERS += vercmpcorpus.h \
+           ../pacmansync.h \
+           ../updatecheck.h
+
+RESOURCES += ../resources.qrc
+
+INCLUDEPATH += ..
+
+QT += core gui concurrent
+lessThan(QT_MAJOR_VERSION, 6): error("Qt 6 or later is required")
+CONFIG += c++23 console
+CONFIG += link_pkgconfig
+PKGCONFIG += zlib libzstd
+CONFIG -= app_bundle
@@ -0,0 +1,681 @@
+#include <QCommandLineParser>
+#include <QGuiApplication>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QFile>
+#include <QPainter>
+#include <QProcess>
+#include <QProcessEnvironment>
+#include <QTemporaryDir>
+#include <QTextStream>
+#include <QVector>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <functional>
+#include <iterator>
+#include <utility>
+
+#include <sys/resource.h>
+
+#include "diagnostics.h"
+#include "pacmandb.h"
+#include "pacmansync.h"
+#include "trayicon.h"
+#include "updatecheck.h"
+#include "updaterecord.h"
+#include "vercmp.h"
+#include "vercmpcorpus.h"
+
+// Counts every heap allocation in the process, including those made inside
+// Qt, by interposing the allocator entry points
+static std::atomic<quint64> allocations{0};
+
+#if defined(__GLIBC__)
+extern "C" {
+void *__libc_malloc(std::size_t size);
+void *__libc_calloc(std::size_t count, std::size_t size);
+void *__libc_realloc(void *ptr, std::size_t size);
+
+void *malloc(std::size_t size) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    return __libc_malloc(size);
+}
+
+void *calloc(std::size_t count, std::size_t size) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    return __libc_calloc(count, size);
+}
+
+void *realloc(void *ptr, std::size_t size) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    return __libc_realloc(ptr, size);
+}
+}
+#endif
+
+// Wall time, CPU time of this process and its children, allocations and
+// peak RSS between start() and stop()
+class PhaseProbe {
+public:
+    struct Result {
+        double wallMs = 0;
+        double cpuMs = 0;
+        double childCpuMs = 0;
+        quint64 allocations = 0;
+        qint64 peakRssKb = -1;
+    };
+
+    void start() {
+        // Resets VmHWM so the peak belongs to this phase (Linux 4.0+)
+        QFile clearRefs("/proc/self/clear_refs");
+        if (clearRefs.open(QIODevice::WriteOnly)) clearRefs.write("5");
+
+        startAllocations = allocations.load(std::memory_order_relaxed);
+        startCpu = cpuMs(RUSAGE_SELF);
+        startChildCpu = cpuMs(RUSAGE_CHILDREN);
+        timer.start();
+    }
+
+    Result stop() const {
+        Result result;
+        result.wallMs = timer.nsecsElapsed() / 1e6;
+        result.cpuMs = cpuMs(RUSAGE_SELF) - startCpu;
+        result.childCpuMs = cpuMs(RUSAGE_CHILDREN) - startChildCpu;
+        result.allocations = allocations.load(std::memory_order_relaxed) - startAllocations;
+        result.peakRssKb = peakRssKb();
+        return result;
+    }
+
+private:
+    static double cpuMs(int who) {
+        struct rusage usage;
+        getrusage(who, &usage);
+        return (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1e3
+             + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e3;
+    }
+
+    static qint64 peakRssKb() {
+        QFile status("/proc/self/status");
+        if (!status.open(QIODevice::ReadOnly)) return -1;
+        for (const QByteArray &line : status.readAll().split('\n')) {
+            if (line.startsWith("VmHWM:")) return line.mid(6).trimmed().split(' ').first().toLongLong();
+        }
+        return -1;
+    }
+
+    QElapsedTimer timer;
+    quint64 startAllocations = 0;
+    double startCpu = 0;
+    double startChildCpu = 0;
+};
+
+// Builds output shaped like the real package manager for `count` updates
+static QByteArray generateOutput(UpdateFormat format, int count) {
+    QByteArray out;
+    if (format == UpdateFormat::Apt) out += "Listing...\n";
+    if (format == UpdateFormat::Pkcon) out += "Getting updates\t[=========================]\nResults:\n";
+    if (format == UpdateFormat::Snap) out += "Name  Version  Rev  Size  Publisher  Notes\n";
+    if (format == UpdateFormat::Fwupd) out += "{\"Devices\":[";
+
+    for (int i = 0; i < count; ++i) {
+        QByteArray name = "package-" + QByteArray::number(i);
+        QByteArray major = QByteArray::number(i % 17);
+        switch (format) {
+        case UpdateFormat::Checkupdates:
+            out += name + ' ' + major + ".2.3-1 -> " + major + ".2.4-1\n";
+            break;
+        case UpdateFormat::Apt:
+            out += name + "/jammy-updates,jammy-security " + major + ".2.4-0ubuntu1 amd64 [upgradable from: "
+                 + major + ".2.3-0ubuntu1]\n";
+            break;
+        case UpdateFormat::Pkcon:
+            out += "Normal               \t" + name + '-' + major + ".2.4-0ubuntu1.amd64 (jammy-updates)\n";
+            break;
+        case UpdateFormat::Flatpak:
+            out += "org.example.App" + QByteArray::number(i) + '\t' + major + ".2.4\tflathub\n";
+            break;
+        case UpdateFormat::Snap:
+            out += name + "  " + major + ".2.4  " + QByteArray::number(1000 + i) + "  12MB  publisher  -\n";
+            break;
+        case UpdateFormat::Fwupd:
+            if (i) out += ',';
+            out += "{\"Name\":\"Device " + QByteArray::number(i) + "\",\"Version\":\"" + major +
+                   ".2.3\",\"Releases\":[{\"Version\":\"" + major + ".2.4\",\"RemoteId\":\"lvfs\"}]}";
+            break;
+        }
+    }
+    if (format == UpdateFormat::Fwupd) out += "]}\n";
+    return out;
+}
+
+static const char *formatName(UpdateFormat format) {
+    switch (format) {
+    case UpdateFormat::Checkupdates: return "checkupdates";
+    case UpdateFormat::Apt: return "apt";
+    case UpdateFormat::Pkcon: return "pkcon";
+    case UpdateFormat::Flatpak: return "flatpak";
+    case UpdateFormat::Snap: return "snap";
+    case UpdateFormat::Fwupd: return "fwupd";
+    }
+    return "?";
+}
+
+// Feeds the output in pipe-sized chunks, the way UpdateCheck delivers it
+static qint64 parseOnce(UpdateFormat format, const QByteArray &output, int &records) {
+    constexpr qsizetype chunkSize = 64 * 1024;
+
+    QElapsedTimer timer;
+    timer.start();
+
+    UpdateParser parser(format);
+    for (qsizetype pos = 0; pos < output.size(); pos += chunkSize) {
+        parser.feed(QByteArray::fromRawData(output.constData() + pos, qMin(chunkSize, output.size() - pos)));
+    }
+    parser.finish();
+
+    qint64 elapsed = timer.nsecsElapsed();
+    records = parser.result().count();
+    return elapsed;
+}
+
+static void benchParser(QTextStream &out) {
+    constexpr int runs = 15;
+    const int sizes[] = { 100, 10000, 100000 };
+    const UpdateFormat formats[] = { UpdateFormat::Checkupdates, UpdateFormat::Apt, UpdateFormat::Pkcon,
+                                     UpdateFormat::Flatpak, UpdateFormat::Snap, UpdateFormat::Fwupd };
+
+    out << "parser: format, lines, bytes, median ms, lines/s, MB/s\n";
+    for (UpdateFormat format : formats) {
+        for (int size : sizes) {
+            QByteArray output = generateOutput(format, size);
+
+            QVector<qint64> samples;
+            int records = 0;
+            for (int i = 0; i < runs; ++i) {
+                samples.append(parseOnce(format, output, records));
+            }
+            std::sort(samples.begin(), samples.end());
+            qint64 median = samples.at(runs / 2);
+
+            if (records != size) {
+                out << "  " << formatName(format) << ": parsed " << records << " of " << size << " records\n";
+            }
+
+            double seconds = median / 1e9;
+            out << "  " << formatName(format) << ", " << size << ", " << output.size() << ", "
+                << QString::number(median / 1e6, 'f', 3) << ", "
+                << QString::number(size / seconds, 'f', 0) << ", "
+                << QString::number(output.size() / seconds / 1e6, 'f', 1) << '\n';
+        }
+    }
+}
+
+// Writes a pacman local database with `count` packages under `root`
+static void generateLocalDb(const QString &root, int count) {
+    QDir().mkpath(root);
+    for (int i = 0; i < count; ++i) {
+        QByteArray name = "package-" + QByteArray::number(i);
+        QByteArray version = QByteArray::number(i % 17) + ".2.3-1";
+        QString dir = root + '/' + QString::fromUtf8(name + '-' + version);
+        QDir().mkpath(dir);
+
+        QFile desc(dir + "/desc");
+        desc.open(QIODevice::WriteOnly);
+        desc.write("%NAME%\n" + name + "\n\n%VERSION%\n" + version + "\n\n%BASE%\n" + name
+                   + "\n\n%DESC%\nSynthetic package for benchmarking\n\n%ARCH%\nx86_64\n\n"
+                   "%BUILDDATE%\n1700000000\n\n%INSTALLDATE%\n1700000000\n\n%SIZE%\n123456\n\n");
+    }
+}
+
+static double timeMs(const std::function<void()> &fn) {
+    QElapsedTimer timer;
+    timer.start();
+    fn();
+    return timer.nsecsElapsed() / 1e6;
+}
+
+static void benchLocalDb(QTextStream &out) {
+    constexpr int packages = 2000;
+
+    QTemporaryDir tmp;
+    QString root = tmp.path() + "/local";
+    QString cache = tmp.path() + "/pacman-local.cache";
+    generateLocalDb(root, packages);
+
+    out << "pacman local db: " << packages << " packages\n";
+
+    PacmanLocalDb cold(root, cache);
+    int parsed = 0;
+    out << "  cold refresh: " << timeMs([&] { parsed = cold.refresh(); }) << " ms (" << parsed << " parsed)\n";
+    out << "  save cache: " << timeMs([&] { cold.save(); }) << " ms\n";
+
+    PacmanLocalDb warm(root, cache);
+    out << "  load cache: " << timeMs([&] { warm.load(); }) << " ms\n";
+    out << "  unchanged refresh: " << timeMs([&] { parsed = warm.refresh(); }) << " ms (" << parsed << " parsed)\n";
+
+    // Simulate a small upgrade touching a handful of packages
+    for (int i = 0; i < 10; ++i) {
+        QString desc = root + QString("/package-%1-%2.2.3-1/desc").arg(i).arg(i % 17);
+        QFile file(desc);
+        file.open(QIODevice::Append);
+        file.write("\n");
+    }
+    out << "  refresh after 10 changes: " << timeMs([&] { parsed = warm.refresh(); }) << " ms (" << parsed
+        << " parsed)\n";
+
+    if (warm.count() != packages) {
+        out << "  index holds " << warm.count() << " of " << packages << " packages\n";
+    }
+}
+
+// What the native pacman check takes from pacman.conf: the repositories
+// in order and which upgrades IgnorePkg and IgnoreGroup hold back, matched
+// as globs with '!' exceptions like libalpm does
+static int checkPacmanConf(QTextStream &out) {
+    QTemporaryDir tmp;
+    QFile file(tmp.path() + "/pacman.conf");
+    if (!file.open(QIODevice::WriteOnly)) return 1;
+    file.write("[options]\n"
+               "IgnorePkg = foo linux*  # kernels by hand\n"
+               "IgnorePkg = !linux-firmware\n"
+               "IgnoreGroup = gnome\n"
+               "[core]\nInclude = /etc/pacman.d/mirrorlist\n"
+               "[extra]\nInclude = /etc/pacman.d/mirrorlist\n");
+    file.close();
+
+    PacmanConf conf = PacmanConf::load(file.fileName());
+    struct Case {
+        const char *name;
+        QList<QByteArray> groups;
+        bool ignored;
+    };
+    const Case cases[] = {
+        { "foo", {}, true },
+        { "vim", {}, false },
+        { "linux-lts", {}, true },
+        { "linux-firmware", {}, false },
+        { "gedit", { "gnome" }, true },
+        { "gnome-shell-extras", { "gnome-extra" }, false },
+        { "dolphin", { "kde-applications", "kde-system" }, false },
+    };
+
+    int failures = conf.repos == QStringList{ "core", "extra" } ? 0 : 1;
+    if (failures) out << "  pacman.conf repositories: " << conf.repos.join(' ') << '\n';
+    for (const Case &c : cases) {
+        if (conf.ignores(c.name, c.groups) == c.ignored) continue;
+        out << "  pacman.conf mismatch: " << c.name << (c.ignored ? " not" : "") << " ignored\n";
+        ++failures;
+    }
+    out << "pacman.conf: " << std::size(cases) << " cases, " << failures << " mismatches\n";
+    return failures;
+}
+
+// Checks a comparison function against a corpus in both directions
+template <std::size_t N, typename F>
+static int verifyCorpus(QTextStream &out, const char *name, const VercmpCase (&corpus)[N], F &&compare) {
+    int failures = 0;
+    for (const VercmpCase &c : corpus) {
+        int forward = compare(c.a, c.b);
+        int backward = compare(c.b, c.a);
+        auto sign = [](int v) { return v < 0 ? -1 : (v > 0 ? 1 : 0); };
+        if (sign(forward) != c.expected || sign(backward) != -c.expected) {
+            out << "  " << name << " mismatch: " << c.a << " vs " << c.b << " gave " << forward
+                << ", expected " << c.expected << '\n';
+            ++failures;
+        }
+    }
+    return failures;
+}
+
+template <std::size_t N, typename F>
+static double comparisonsPerSecond(const VercmpCase (&corpus)[N], F &&compare) {
+    constexpr int rounds = 20000;
+    volatile int sink = 0;
+
+    QElapsedTimer timer;
+    timer.start();
+    for (int round = 0; round < rounds; ++round) {
+        for (const auto &c : corpus) sink = sink + compare(c);
+    }
+    return double(rounds) * N / (timer.nsecsElapsed() / 1e9);
+}
+
+static void benchVercmp(QTextStream &out) {
+    out << "vercmp: corpus check and comparisons/s\n";
+
+    int failures = verifyCorpus(out, "alpm", alpmCorpus, [](const char *a, const char *b) {
+        return Vercmp::alpm(a, b);
+    });
+    failures += verifyCorpus(out, "dpkg", dpkgCorpus, [](const char *a, const char *b) {
+        return Vercmp::dpkg(a, b);
+    });
+    out << "  corpus: " << (std::size(alpmCorpus) + std::size(dpkgCorpus)) << " pairs, " << failures
+        << " mismatches\n";
+
+    // Views and pre-split forms are built up front, as a caller on a hot
+    // path would hold them
+    struct Split {
+        Vercmp::AlpmVersion alpmA, alpmB;
+        Vercmp::DpkgVersion dpkgA, dpkgB;
+    };
+    QVector<Split> alpmSplit, dpkgSplit;
+    for (const VercmpCase &c : alpmCorpus) {
+        alpmSplit.append({ Vercmp::AlpmVersion(c.a), Vercmp::AlpmVersion(c.b), {}, {} });
+    }
+    for (const VercmpCase &c : dpkgCorpus) {
+        dpkgSplit.append({ {}, {}, Vercmp::DpkgVersion(c.a), Vercmp::DpkgVersion(c.b) });
+    }
+
+    out << "  alpm: " << QString::number(comparisonsPerSecond(alpmCorpus, [](const VercmpCase &c) {
+        return Vercmp::alpm(c.a, c.b);
+    }), 'f', 0) << '\n';
+    out << "  dpkg: " << QString::number(comparisonsPerSecond(dpkgCorpus, [](const VercmpCase &c) {
+        return Vercmp::dpkg(c.a, c.b);
+    }), 'f', 0) << '\n';
+
+    int i = 0;
+    out << "  alpm pre-split: " << QString::number(comparisonsPerSecond(alpmCorpus, [&](const VercmpCase &) {
+        const Split &s = alpmSplit.at(i++ % alpmSplit.size());
+        return Vercmp::alpm(s.alpmA, s.alpmB);
+    }), 'f', 0) << '\n';
+    i = 0;
+    out << "  dpkg pre-split: " << QString::number(comparisonsPerSecond(dpkgCorpus, [&](const VercmpCase &) {
+        const Split &s = dpkgSplit.at(i++ % dpkgSplit.size());
+        return Vercmp::dpkg(s.dpkgA, s.dpkgB);
+    }), 'f', 0) << '\n';
+}
+
+// Installs stand-ins for checkupdates, apt and pkcon that print a fixture
+// after a configurable delay, the way the real tools would
+static bool installFakeTools(const QString &binDir) {
+    static const char script[] =
+        "#!/bin/sh\n"
+        "sleep \"${KDEUPDATER_BENCH_LATENCY:-0}\"\n"
+        "[ \"$(basename \"$0\")\" = apt ] && echo 'WARNING: apt does not have a stable CLI interface.' >&2\n"
+        "exec cat \"${KDEUPDATER_BENCH_FIXTURE:-$KDEUPDATER_BENCH_FIXTURES/$(basename \"$0\").txt}\"\n";
+
+    if (!QDir().mkpath(binDir)) return false;
+    for (const char *tool : { "checkupdates", "apt", "pkcon" }) {
+        QFile file(binDir + '/' + tool);
+        if (!file.open(QIODevice::WriteOnly) || file.write(script) < 0) return false;
+        file.setPermissions(file.permissions() | QFileDevice::ExeOwner);
+    }
+    qputenv("PATH", QFile::encodeName(binDir) + ':' + qgetenv("PATH"));
+    return true;
+}
+
+static void printPhase(QTextStream &out, const char *format, int size, const char *phase,
+                       const PhaseProbe::Result &r, double firstByteMs = -1) {
+    out << "  " << format << ", " << size << ", " << phase << ", "
+        << QString::number(r.wallMs, 'f', 2) << ", "
+        << (firstByteMs < 0 ? QString("-") : QString::number(firstByteMs, 'f', 2)) << ", "
+        << QString::number(r.cpuMs, 'f', 2) << ", "
+        << QString::number(r.childCpuMs, 'f', 2) << ", "
+        << r.allocations << ", " << r.peakRssKb << '\n';
+}
+
+// Runs the same check -> parse -> list path as the tray, end to end
+// against the fake tools
+static void benchPipeline(QTextStream &out, const QVector<int> &sizes, int latencyMs) {
+    QTemporaryDir tmp;
+    if (!installFakeTools(tmp.path() + "/bin")) {
+        out << "pipeline: cannot install fake package manager tools\n";
+        return;
+    }
+    qputenv("KDEUPDATER_BENCH_LATENCY", QByteArray::number(latencyMs / 1000.0, 'f', 3));
+
+    struct Tool {
+        UpdateFormat format;
+        const char *program;
+        QStringList args;
+    };
+    const Tool tools[] = {
+        { UpdateFormat::Checkupdates, "checkupdates", {} },
+        { UpdateFormat::Apt, "apt", { "list", "--upgradable" } },
+        { UpdateFormat::Pkcon, "pkcon", { "get-updates" } },
+    };
+
+    out << "pipeline: latency " << latencyMs << " ms\n";
+    out << "  format, updates, phase, wall ms, first byte ms, cpu ms, child cpu ms, allocations, peak rss kB\n";
+    for (const Tool &tool : tools) {
+        for (int size : sizes) {
+            QString fixture = tmp.path() + QString("/%1-%2.txt").arg(tool.program).arg(size);
+            QFile file(fixture);
+            if (!file.open(QIODevice::WriteOnly)) continue;
+            file.write(generateOutput(tool.format, size));
+            file.close();
+            qputenv("KDEUPDATER_BENCH_FIXTURE", QFile::encodeName(fixture));
+
+            UpdateCheck check;
+            QEventLoop loop;
+            UpdateList updates;
+            double firstByteMs = -1;
+            PhaseProbe probe;
+
+            QObject::connect(&check, &UpdateCheck::outputReady, &loop, [&]() {
+                if (firstByteMs < 0) firstByteMs = probe.stop().wallMs;
+            });
+            QObject::connect(&check, &UpdateCheck::finished, &loop,
+                             [&](const UpdateList &list, const QByteArray &, int) {
+                updates = list;
+                loop.quit();
+            });
+
+            probe.start();
+            check.start(tool.program, tool.args, tool.format);
+            loop.exec();
+            printPhase(out, tool.program, size, "check", probe.stop(), firstByteMs);
+
+            if (updates.count() != size) {
+                out << "  " << tool.program << ": parsed " << updates.count() << " of " << size << " updates\n";
+            }
+
+            probe.start();
+            QString text = updates.toText();
+            QString toolTip = QString("Update Checker - %1 updates available").arg(updates.count());
+            printPhase(out, tool.program, size, "list", probe.stop());
+            Q_UNUSED(text);
+            Q_UNUSED(toolTip);
+        }
+    }
+}
+
+// Tray icon rendering as during an install: the first icon, a progress
+// sweep with an empty cache and again with a warm one, and the sweep
+// rasterizing the SVG for every step as a baseline
+static void benchIcon(QTextStream &out) {
+    out << "icon: dpr, case, calls, total ms, us/call, svg renders, painted, cache hits\n";
+    for (qreal dpr : { 1.0, 2.0 }) {
+        TrayIconRenderer renderer;
+        auto report = [&](const char *name, int calls, double ms, const TrayIconRenderer::Stats &before) {
+            const TrayIconRenderer::Stats &after = renderer.stats();
+            out << "  " << dpr << ", " << name << ", " << calls << ", " << QString::number(ms, 'f', 3) << ", "
+                << QString::number(ms * 1000 / calls, 'f', 1) << ", " << after.svgRenders - before.svgRenders << ", "
+                << after.composed - before.composed << ", " << after.hits - before.hits << '\n';
+        };
+        auto sweep = [&]() {
+            for (int percent = 0; percent <= 100; ++percent) renderer.icon(TrayIconRenderer::Installing, 42, percent, dpr);
+        };
+
+        TrayIconRenderer::Stats before = renderer.stats();
+        report("first", 1, timeMs([&]() { renderer.icon(TrayIconRenderer::UpdatesAvailable, 42, -1, dpr); }), before);
+        before = renderer.stats();
+        report("sweep cold", 101, timeMs(sweep), before);
+        before = renderer.stats();
+        report("sweep warm", 101, timeMs(sweep), before);
+
+        double uncachedMs = timeMs([dpr]() {
+            for (int percent = 0; percent <= 100; ++percent) {
+                QPixmap pixmap = QIcon(":/images/updates.svg").pixmap(QSize(64, 64), dpr);
+                QPainter painter(&pixmap);
+                painter.setRenderHint(QPainter::Antialiasing);
+                painter.setPen(QPen(QColor("#24ffff"), 6, Qt::SolidLine, Qt::FlatCap));
+                painter.drawArc(QRectF(3, 3, 58, 58), 90 * 16, -percent * 360 * 16 / 100);
+            }
+        });
+        out << "  " << dpr << ", sweep uncached, 101, " << QString::number(uncachedMs, 'f', 3) << ", "
+            << QString::number(uncachedMs * 1000 / 101, 'f', 1) << ", 101, 101, 0\n";
+    }
+}
+
+// What a result costs to keep between checks: the parsed output as it
+// arrives against the compacted copy, and the resident size over many
+// re-checks that each swap in a new generation
+static void benchStore(QTextStream &out) {
+    out << "store: format, updates, raw bytes, compacted bytes, compact ms\n";
+    for (UpdateFormat format : { UpdateFormat::Checkupdates, UpdateFormat::Apt, UpdateFormat::Pkcon }) {
+        for (int size : { 100, 10000, 100000 }) {
+            UpdateParser parser(format);
+            parser.feed(generateOutput(format, size));
+            parser.finish();
+            UpdateList raw = parser.take();
+
+            UpdateList compact;
+            double ms = timeMs([&]() { compact = raw.compacted(); });
+            out << "  " << formatName(format) << ", " << size << ", " << raw.buffer.size() << ", "
+                << compact.buffer.size() << ", " << QString::number(ms, 'f', 3) << '\n';
+        }
+    }
+
+    constexpr int checks = 500;
+    out << "store: re-checks of 10000 apt updates, rss kb at start, rss kb after " << checks << '\n';
+    UpdateList kept;
+    trimHeap();
+    qint64 startRss = residentSetKb();
+    for (int i = 0; i < checks; ++i) {
+        UpdateParser parser(UpdateFormat::Apt);
+        parser.feed(generateOutput(UpdateFormat::Apt, 10000 + i % 7));
+        parser.finish();
+        kept = parser.take().compacted();
+    }
+    trimHeap();
+    out << "  " << startRss << ", " << residentSetKb() << '\n';
+}
+
+// The command line mode end to end against the fake tools: a forced check
+// that saves its result, then the cached path that must answer from it.
+// Every tool prints the same updates in its own format, so whichever
+// backend the host detects has to report all of them. Each run is
+// bounded, so a mode that never exits shows up as "hung".
+static int benchCli(QTextStream &out, const QString &binary) {
+    constexpr int count = 100;
+    QTemporaryDir tmp;
+    if (!installFakeTools(tmp.path() + "/bin")) {
+        out << "cli: cannot install fake package manager tools\n";
+        return 1;
+    }
+    const std::pair<const char *, UpdateFormat> fixtures[] = {
+        { "checkupdates", UpdateFormat::Checkupdates },
+        { "apt", UpdateFormat::Apt },
+        { "pkcon", UpdateFormat::Pkcon },
+    };
+    for (const auto &[tool, format] : fixtures) {
+        QFile file(tmp.path() + "/fixtures/" + tool + ".txt");
+        if (!QDir().mkpath(tmp.path() + "/fixtures") || !file.open(QIODevice::WriteOnly)) return 1;
+        file.write(generateOutput(format, count));
+    }
+
+    // Settings and the saved result of a clean user, and no shared cache:
+    // the fake result must not reach the other sessions on the machine
+    QProcessEnvironment env = QProcessEnvironment::systemEnvironment();
+    env.remove("KDEUPDATER_BENCH_FIXTURE");
+    env.insert("KDEUPDATER_BENCH_FIXTURES", tmp.path() + "/fixtures");
+    env.insert("KDEUPDATER_BENCH_LATENCY", "0");
+    env.insert("KDEUPDATER_SHARED_CACHE", QString());
+    env.insert("XDG_CACHE_HOME", tmp.path() + "/cache");
+    env.insert("XDG_CONFIG_HOME", tmp.path() + "/config");
+
+    struct Run {
+        const char *name;
+        QStringList args;
+    };
+    const Run runs[] = {
+        { "refresh", { "--check", "--refresh", "--count", "--timing" } },
+        { "cached", { "--check", "--count", "--timing" } },
+        { "cached json", { "--check", "--json" } },
+    };
+
+    int failures = 0;
+    out << "cli: run, exit status, wall ms, stdout\n";
+    for (const Run &run : runs) {
+        QProcess process;
+        process.setProcessEnvironment(env);
+        QElapsedTimer timer;
+        timer.start();
+        process.start(binary, run.args);
+        bool exited = process.waitForFinished(10 * 1000);
+        double ms = timer.nsecsElapsed() / 1e6;
+        if (!exited) {
+            process.kill();
+            process.waitForFinished();
+        }
+
+        QByteArray output = process.readAllStandardOutput().trimmed();
+        out << "  " << run.name << ", " << (exited ? QString::number(process.exitCode()) : QString("hung")) << ", "
+            << QString::number(ms, 'f', 2) << ", " << output.left(80) << '\n';
+        QByteArray timing = process.readAllStandardError().trimmed();
+        if (!timing.isEmpty()) out << "    " << timing << '\n';
+
+        if (!exited || process.exitStatus() != QProcess::NormalExit) ++failures;
+        if (qstrcmp(run.name, "refresh") == 0 && exited && output != QByteArray::number(count)) {
+            out << "  refresh: expected " << count << " updates\n";
+            ++failures;
+        }
+        if (qstrcmp(run.name, "cached json") == 0 && exited && !output.contains("\"cached\":true")) {
+            out << "  cached json: the saved result was not used\n";
+            ++failures;
+        }
+    }
+    return failures;
+}
+
+static QVector<int> parseSizes(const QString &value) {
+    QVector<int> sizes;
+    for (const QString &part : value.split(',', Qt::SkipEmptyParts)) {
+        bool ok = false;
+        int size = part.trimmed().toInt(&ok);
+        if (ok && size >= 0) sizes.append(size);
+    }
+    return sizes;
+}
+
+int main(int argc, char *argv[]) {
+    // Icons are rendered without a display
+    if (!qEnvironmentVariableIsSet("QT_QPA_PLATFORM")) qputenv("QT_QPA_PLATFORM", "offscreen");
+    QGuiApplication app(argc, argv);
+    QTextStream out(stdout);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Benchmarks for the update checker");
+    parser.addHelpOption();
+    QCommandLineOption sectionOption("section", "Run only this section: parser, localdb, vercmp, pipeline, icon, store or cli.", "name");
+    QCommandLineOption sizesOption("sizes", "Update counts for the pipeline fixtures.", "list", "0,100,10000,100000");
+    QCommandLineOption latencyOption("latency", "Delay of the fake package manager tools.", "ms", "0");
+    QCommandLineOption binaryOption("binary", "The update checker binary for the cli section.", "path",
+                                    QCoreApplication::applicationDirPath() + "/../kdeupdater.bin");
+    parser.addOptions({ sectionOption, sizesOption, latencyOption, binaryOption });
+    parser.process(app);
+
+    QStringList sections = parser.values(sectionOption);
+    auto enabled = [&sections](const char *name) { return sections.isEmpty() || sections.contains(name); };
+
+    // Sections that check behaviour fail the run; scripts rely on the cli
+    // exiting
+    int failures = 0;
+    if (enabled("parser")) benchParser(out);
+    if (enabled("localdb")) {
+        benchLocalDb(out);
+        failures += checkPacmanConf(out);
+    }
+    if (enabled("vercmp")) benchVercmp(out);
+    if (enabled("pipeline")) benchPipeline(out, parseSizes(parser.value(sizesOption)), parser.value(latencyOption).toInt());
+    if (enabled("icon")) benchIcon(out);
+    if (enabled("store")) benchStore(out);
+
+    if (enabled("cli")) failures += benchCli(out, parser.value(binaryOption));
+
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,102 @@
+#ifndef VERCMPCORPUS_H
+#define VERCMPCORPUS_H
+
+// Reference orderings for the version comparison benchmark. The alpm cases
+// are pacman's own vercmp test suite plus a few real package versions; the
+// dpkg cases were recorded from `dpkg --compare-versions`. Every pair is
+// also checked in reverse.
+struct VercmpCase {
+    const char *a;
+    const char *b;
+    int expected;
+};
+
+static const VercmpCase alpmCorpus[] = {
+    { "1.5.0", "1.5.0", 0 },
+    { "1.5.1", "1.5.0", 1 },
+    { "1.5.1", "1.5", 1 },
+    { "1.5.0-1", "1.5.0-1", 0 },
+    { "1.5.0-1", "1.5.0-2", -1 },
+    { "1.5.0-1", "1.5.1-1", -1 },
+    { "1.5.0-2", "1.5.1-1", -1 },
+    { "1.5-1", "1.5.1-1", -1 },
+    { "1.5-2", "1.5.1-1", -1 },
+    { "1.5-2", "1.5.1-2", -1 },
+    { "1.5", "1.5-1", 0 },
+    { "1.5-1", "1.5", 0 },
+    { "1.1-1", "1.1", 0 },
+    { "1.0-1", "1.1", -1 },
+    { "1.1-1", "1.0", 1 },
+    { "1.5b-1", "1.5-1", -1 },
+    { "1.5b", "1.5", -1 },
+    { "1.5b-1", "1.5", -1 },
+    { "1.5b", "1.5.1", -1 },
+    { "1.0a", "1.0alpha", -1 },
+    { "1.0alpha", "1.0b", -1 },
+    { "1.0b", "1.0beta", -1 },
+    { "1.0beta", "1.0rc", -1 },
+    { "1.0rc", "1.0", -1 },
+    { "1.5.a", "1.5", 1 },
+    { "1.5.b", "1.5.a", 1 },
+    { "1.5.1", "1.5.b", 1 },
+    { "1.5.b-1", "1.5.b", 0 },
+    { "1.5-1", "1.5.b", -1 },
+    { "2.0", "2_0", 0 },
+    { "2.0_a", "2_0.a", 0 },
+    { "2.0a", "2.0.a", -1 },
+    { "2___a", "2_a", 1 },
+    { "0:1.0", "0:1.0", 0 },
+    { "0:1.0", "0:1.1", -1 },
+    { "1:1.0", "0:1.0", 1 },
+    { "1:1.0", "0:1.1", 1 },
+    { "1:1.0", "2:1.1", -1 },
+    { "1:1.0", "0:1.0-1", 1 },
+    { "1:1.0-1", "0:1.1-1", 1 },
+    { "0:1.0", "1.0", 0 },
+    { "0:1.0", "1.1", -1 },
+    { "0:1.1", "1.0", 1 },
+    { "1:1.0", "1.0", 1 },
+    { "1:1.0", "1.1", 1 },
+    { "1:1.1", "1.1", 1 },
+    { "6.1.2.arch1-1", "6.1.1.arch1-1", 1 },
+    { "1:2.2.2-1", "1:2.2.10-1", -1 },
+    { "r1234.abcdef-1", "r1233.ffffff-1", 1 },
+    { "1.0~rc1", "1.0", 1 },
+};
+
+static const VercmpCase dpkgCorpus[] = {
+    { "1.0", "1.0", 0 },
+    { "1.0", "1.1", -1 },
+    { "1.0~rc1", "1.0", -1 },
+    { "1.0~~", "1.0~", -1 },
+    { "1.0~", "1.0", -1 },
+    { "1.0+b1", "1.0", 1 },
+    { "1.0-1", "1.0-2", -1 },
+    { "1.0-1ubuntu1", "1.0-1", 1 },
+    { "1.0", "1.0-0", 0 },
+    { "1:1.0", "2.0", 1 },
+    { "0:1.0", "1.0", 0 },
+    { "2:0.1", "1:9.9", 1 },
+    { "1.01", "1.1", 0 },
+    { "1.0a", "1.0", 1 },
+    { "1.0.", "1.0", 1 },
+    { "1.0a", "1.0.", -1 },
+    { "1.0-1~bpo12+1", "1.0-1", -1 },
+    { "2.35-0ubuntu3.4", "2.35-0ubuntu3.10", -1 },
+    { "115.0+build2-0ubuntu0.22.04.1", "114.0+build1-0ubuntu0.22.04.1", 1 },
+    { "1:2.38.1-5+deb12u1", "1:2.38.1-5", 1 },
+    { "7.88.1-10+deb12u5", "7.88.1-10+deb12u12", -1 },
+    { "5.15.0-91.101", "5.15.0-101.111", -1 },
+    { "1.2.3+dfsg-1", "1.2.3-1", 1 },
+    { "1.2.3+dfsg-1", "1.2.3+dfsg1-1", -1 },
+    { "0.0.0~git20230101.abcdef-1", "0.0.0~git20221231.ffffff-1", 1 },
+    { "3.0.11-1~deb12u2", "3.0.11-1", -1 },
+    { "1.0-1.1", "1.0-1", 1 },
+    { "1.0a", "1.0b", -1 },
+    { "1.0A", "1.0a", -1 },
+    { "10", "9", 1 },
+    { "009", "9", 0 },
+    { "1.0-0ubuntu0.22.04.1", "1.0-0ubuntu0.20.04.1", 1 },
+};
+
+#endif // VERCMPCORPUS_H
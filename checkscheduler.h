@@ -0,0 +1,215 @@
+#ifndef CHECKSCHEDULER_H
+#define CHECKSCHEDULER_H
+
+#include <QElapsedTimer>
+#include <QObject>
+#include <QRandomGenerator>
+#include <QTimer>
+
+#include <algorithm>
+#include <functional>
+
+#include "lockwatcher.h"
+#include "updatecheck.h"
+
+// Funnels every reason to check for updates into at most one running
+// check. A request made while a check is running joins it and is answered
+// by the same finished() signal, unless the package databases changed
+// after the run began; then the run is stale and is restarted. Automatic
+// requests closer than the minimum interval to the last check are
+// deferred until it has passed, and several deferred requests end up as
+// one check. Requests from clients of the update service within that
+// interval are answered by the last result instead. The interval counts
+// from the last result the owner reported, whether its own check's or one
+// taken from elsewhere, and a request while the owner is busy getting one
+// without `check` joins that.
+//
+// While the package manager holds its lock a check would only fail, so it
+// waits instead: until the lock file is released, or failing that for an
+// exponentially growing, jittered delay. After MaxLockRetries the check
+// runs anyway so a stale lock surfaces as the package manager's own error.
+class CheckScheduler : public QObject {
+    Q_OBJECT
+public:
+    enum class Trigger {
+        Startup,
+        Timer,
+        DatabaseChange,
+        Manual,
+        AfterInstall,
+        Remote      // a client of the update service
+    };
+
+    CheckScheduler(UpdateCheck *check, QObject *parent = nullptr) : QObject(parent), check(check) {
+        connect(check, &UpdateCheck::canceled, this, &CheckScheduler::onCanceled);
+
+        deferTimer.setSingleShot(true);
+        // A run that started meanwhile answers the deferred request
+        connect(&deferTimer, &QTimer::timeout, this, [this]() {
+            if (!isBusy()) startRun(deferredTrigger);
+        });
+
+        lockTimer.setSingleShot(true);
+        connect(&lockTimer, &QTimer::timeout, this, &CheckScheduler::retryAfterLock);
+        connect(&lockWatcher, &LockWatcher::released, this, &CheckScheduler::onLockReleased);
+    }
+
+    void setMinimumInterval(int msec) { minimumInterval = msec; }
+
+    void setLock(const QString &file, const std::function<bool()> &isLocked) {
+        lockFile = file;
+        lockHeld = isLocked;
+    }
+
+    // Whether the owner is getting a result some other way, such as from
+    // another session's check; requests then join that
+    void setBusy(const std::function<bool()> &isBusy) { busy = isBusy; }
+
+    bool isWaitingForLock() const { return lockTimer.isActive(); }
+
+    // A check ended or a result came from elsewhere; the minimum interval
+    // runs from here
+    void markChecked() { lastCheck.start(); }
+
+    void request(Trigger trigger) {
+        // Already queued behind the lock
+        if (isWaitingForLock()) return;
+
+        if (check->isRunning()) {
+            if (!isStale(trigger)) return;
+
+            // Results computed from the old databases are of no use
+            restartTrigger = trigger;
+            restartPending = true;
+            check->cancel();
+            return;
+        }
+        if (busy && busy()) return;
+
+        // Many clients asking at once share the result that is there
+        if (trigger == Trigger::Remote && lastCheck.isValid() && lastCheck.elapsed() < minimumInterval) return;
+
+        if (isAutomatic(trigger) && lastCheck.isValid() && lastCheck.elapsed() < minimumInterval) {
+            if (!deferTimer.isActive()) {
+                deferredTrigger = trigger;
+                deferTimer.start(int(minimumInterval - lastCheck.elapsed()));
+            }
+            return;
+        }
+
+        startRun(trigger);
+    }
+
+    // Drops a check waiting for the lock as well as a running one
+    void cancel() {
+        if (isWaitingForLock()) {
+            stopWaiting();
+            emit canceled();
+        } else {
+            check->cancel();
+        }
+    }
+
+    // For a check that failed because the lock was taken while it ran
+    bool retryIfLocked() {
+        if (!lockHeld || !lockHeld()) return false;
+        waitForLock(lastTrigger);
+        return true;
+    }
+
+signals:
+    // The owner starts the check in response; it must run on `check`
+    void runRequested(Trigger trigger);
+    void waitingForLock(int msec);
+    void canceled();
+
+private slots:
+    void onCanceled() {
+        if (!restartPending) {
+            emit canceled();
+            return;
+        }
+        restartPending = false;
+        startRun(restartTrigger);
+    }
+
+    void retryAfterLock() {
+        if (lockHeld() && lockRetries < MaxLockRetries) {
+            waitForLock(lockTrigger);
+            return;
+        }
+        stopWaiting();
+        run(lockTrigger);
+    }
+
+    void onLockReleased() {
+        if (!isWaitingForLock() || lockHeld()) return;
+        stopWaiting();
+        run(lockTrigger);
+    }
+
+private:
+    static bool isAutomatic(Trigger trigger) {
+        return trigger == Trigger::Startup || trigger == Trigger::Timer || trigger == Trigger::DatabaseChange;
+    }
+
+    bool isBusy() const { return check->isRunning() || isWaitingForLock() || (busy && busy()); }
+
+    static bool isStale(Trigger trigger) {
+        return trigger == Trigger::DatabaseChange || trigger == Trigger::AfterInstall;
+    }
+
+    void startRun(Trigger trigger) {
+        deferTimer.stop();
+        if (lockHeld && lockHeld()) {
+            waitForLock(trigger);
+            return;
+        }
+        run(trigger);
+    }
+
+    void run(Trigger trigger) {
+        lastTrigger = trigger;
+        emit runRequested(trigger);
+    }
+
+    void waitForLock(Trigger trigger) {
+        lockTrigger = trigger;
+        if (!lockWatcher.isWatching() && !lockFile.isEmpty()) lockWatcher.watch(lockFile);
+
+        // 5 s doubling up to 5 min, spread by +-25% so several clients
+        // waiting on the same lock do not all retry at once
+        int delay = std::min(5000 << std::min(lockRetries, 6), 5 * 60 * 1000);
+        delay += QRandomGenerator::global()->bounded(delay / 2) - delay / 4;
+        ++lockRetries;
+
+        lockTimer.start(delay);
+        emit waitingForLock(delay);
+    }
+
+    void stopWaiting() {
+        lockTimer.stop();
+        lockWatcher.stop();
+        lockRetries = 0;
+    }
+
+    UpdateCheck *check;
+    QTimer deferTimer;
+    QElapsedTimer lastCheck;
+    int minimumInterval = 60 * 1000;
+    Trigger deferredTrigger = Trigger::Timer;
+    Trigger restartTrigger = Trigger::Timer;
+    Trigger lastTrigger = Trigger::Timer;
+    bool restartPending = false;
+
+    static constexpr int MaxLockRetries = 8;
+    QTimer lockTimer;
+    LockWatcher lockWatcher;
+    QString lockFile;
+    std::function<bool()> lockHeld;
+    std::function<bool()> busy;
+    Trigger lockTrigger = Trigger::Timer;
+    int lockRetries = 0;
+};
+
+#endif // CHECKSCHEDULER_H
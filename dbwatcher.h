@@ -0,0 +1,62 @@
+#ifndef DBWATCHER_H
+#define DBWATCHER_H
+
+#include <QFileInfo>
+#include <QFileSystemWatcher>
+#include <QObject>
+#include <QStringList>
+#include <QTimer>
+
+// Watches the package manager's databases and emits changed() once things
+// settle after a burst of writes, so a check only runs when its answer can
+// actually have changed.
+class DatabaseWatcher : public QObject {
+    Q_OBJECT
+public:
+    DatabaseWatcher(QObject *parent = nullptr) : QObject(parent) {
+        debounceTimer = new QTimer(this);
+        debounceTimer->setSingleShot(true);
+        debounceTimer->setInterval(3000);
+        connect(debounceTimer, &QTimer::timeout, this, &DatabaseWatcher::changed);
+    }
+
+    void watch(const QStringList &paths) {
+        stop();
+        watchedPaths = paths;
+
+        watcher = new QFileSystemWatcher(this);
+        connect(watcher, &QFileSystemWatcher::directoryChanged, this, &DatabaseWatcher::onPathChanged);
+        connect(watcher, &QFileSystemWatcher::fileChanged, this, &DatabaseWatcher::onPathChanged);
+        for (const QString &path : watchedPaths) {
+            if (QFileInfo::exists(path)) watcher->addPath(path);
+        }
+    }
+
+    void stop() {
+        debounceTimer->stop();
+        delete watcher;
+        watcher = nullptr;
+    }
+
+    bool isWatching() const { return watcher && (!watcher->files().isEmpty() || !watcher->directories().isEmpty()); }
+
+signals:
+    void changed();
+
+private slots:
+    void onPathChanged(const QString &path) {
+        // Files replaced by rename (dpkg's status) drop out of the watch
+        if (watchedPaths.contains(path) && !watcher->files().contains(path) &&
+            !watcher->directories().contains(path) && QFileInfo::exists(path)) {
+            watcher->addPath(path);
+        }
+        debounceTimer->start();
+    }
+
+private:
+    QFileSystemWatcher *watcher = nullptr;
+    QTimer *debounceTimer;
+    QStringList watchedPaths;
+};
+
+#endif // DBWATCHER_H
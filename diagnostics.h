@@ -0,0 +1,111 @@
+#ifndef DIAGNOSTICS_H
+#define DIAGNOSTICS_H
+
+#include <QByteArray>
+#include <QDateTime>
+#include <QFile>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QPair>
+#include <QString>
+#include <QVector>
+
+#include <unistd.h>
+
+#if defined(__GLIBC__)
+#include <malloc.h>
+#endif
+
+// Timings and counters of one check or install
+struct DiagnosticSample {
+    QDateTime timestamp = QDateTime::currentDateTime();
+    QString operation;      // "startup", "check" or "install"
+    QString detail;         // backend and how it was queried
+    QString result = "ok";
+    QVector<QPair<QString, qint64>> phasesNs;
+    QVector<QPair<QString, qint64>> counters;
+
+    void addPhase(const QString &name, qint64 ns) {
+        if (ns >= 0) phasesNs.append(qMakePair(name, ns));
+    }
+
+    void addCounter(const QString &name, qint64 value) {
+        counters.append(qMakePair(name, value));
+    }
+
+    QJsonObject toJson() const {
+        QJsonObject phases;
+        for (const auto &phase : phasesNs) phases.insert(phase.first, phase.second / 1e6);
+
+        QJsonObject values;
+        for (const auto &counter : counters) values.insert(counter.first, counter.second);
+
+        QJsonObject object;
+        object.insert("time", timestamp.toString(Qt::ISODateWithMs));
+        object.insert("operation", operation);
+        object.insert("detail", detail);
+        object.insert("result", result);
+        object.insert("phases_ms", phases);
+        object.insert("counters", values);
+        return object;
+    }
+};
+
+// Resident memory of this process in KiB, -1 if unknown
+inline qint64 residentSetKb() {
+    QFile statm("/proc/self/statm");
+    if (!statm.open(QIODevice::ReadOnly)) return -1;
+    QList<QByteArray> fields = statm.readAll().split(' ');
+    if (fields.size() < 2) return -1;
+    return fields.at(1).toLongLong() * (::sysconf(_SC_PAGESIZE) / 1024);
+}
+
+// Gives memory the allocator holds on to back to the system. glibc keeps
+// freed blocks for reuse, so without this a process running for weeks
+// stays at the size of its largest check.
+inline void trimHeap() {
+#if defined(__GLIBC__)
+    ::malloc_trim(0);
+#endif
+}
+
+// The most recent samples in a fixed size ring; older ones are overwritten
+class DiagnosticsLog {
+public:
+    DiagnosticsLog(int capacity = 64) : capacity(capacity) {
+        ring.reserve(capacity);
+    }
+
+    void record(const DiagnosticSample &sample) {
+        if (ring.size() < capacity) {
+            ring.append(sample);
+        } else {
+            ring[next] = sample;
+        }
+        next = (next + 1) % capacity;
+    }
+
+    // Oldest first
+    QVector<DiagnosticSample> samples() const {
+        if (ring.size() < capacity) return ring;
+        QVector<DiagnosticSample> ordered;
+        ordered.reserve(capacity);
+        for (int i = 0; i < capacity; ++i) ordered.append(ring.at((next + i) % capacity));
+        return ordered;
+    }
+
+    QByteArray toJsonLines() const {
+        QByteArray lines;
+        for (const DiagnosticSample &sample : samples()) {
+            lines += QJsonDocument(sample.toJson()).toJson(QJsonDocument::Compact) + '\n';
+        }
+        return lines;
+    }
+
+private:
+    int capacity;
+    int next = 0;
+    QVector<DiagnosticSample> ring;
+};
+
+#endif // DIAGNOSTICS_H
@@ -0,0 +1,230 @@
+#ifndef INSTALLPROGRESS_H
+#define INSTALLPROGRESS_H
+
+#include <QByteArray>
+#include <QByteArrayList>
+
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <string_view>
+
+// How a backend's privileged install reports progress on stdout
+enum class InstallFormat {
+    Pacman,     // pacman --noprogressbar: "upgrading name...", " name downloading..."
+    Apt,        // apt-get -o APT::Status-Fd=1: "dlstatus:" and "pmstatus:" lines
+    Pkcon       // pkcon --plain: "Percentage:<TAB>n", "Status:<TAB>..."
+};
+
+// The last Capacity bytes of a process's output. Lines are handed out as
+// they complete; a line longer than the ring loses its beginning. The kept
+// tail is what gets shown when the process fails.
+template <std::size_t Capacity>
+class OutputRing {
+public:
+    template <typename F>
+    void feed(std::string_view chunk, F &&onLine) {
+        for (char c : chunk) {
+            // Progress bars redraw with carriage returns
+            if (c == '\n' || c == '\r') {
+                emitLine(onLine);
+                put('\n');
+                lineStart = written;
+            } else {
+                put(c);
+            }
+        }
+    }
+
+    // Hands out a final line that was not terminated
+    template <typename F>
+    void finish(F &&onLine) {
+        emitLine(onLine);
+        lineStart = written;
+    }
+
+    // The last `count` non-empty lines still in the ring
+    QByteArray tail(int count) const {
+        std::size_t kept = std::min<quint64>(written, Capacity);
+        QByteArray bytes;
+        bytes.reserve(qsizetype(kept));
+        for (quint64 i = written - kept; i < written; ++i) bytes.append(ring[i % Capacity]);
+
+        QByteArrayList lines = bytes.split('\n');
+        lines.removeAll(QByteArray());
+        if (written > Capacity && !lines.isEmpty()) lines.removeFirst();    // cut off
+        return lines.mid(std::max<qsizetype>(0, lines.size() - count)).join('\n');
+    }
+
+private:
+    void put(char c) {
+        ring[written % Capacity] = c;
+        ++written;
+    }
+
+    template <typename F>
+    void emitLine(F &onLine) {
+        quint64 from = std::max<quint64>(lineStart, written > Capacity ? written - Capacity : 0);
+        std::size_t length = std::size_t(written - from);
+        if (length == 0) return;
+
+        // Copy out in at most two pieces when the line wraps around
+        std::size_t begin = std::size_t(from % Capacity);
+        std::size_t first = std::min(length, Capacity - begin);
+        std::memcpy(line, ring + begin, first);
+        std::memcpy(line + first, ring, length - first);
+        onLine(std::string_view(line, length));
+    }
+
+    char ring[Capacity];
+    char line[Capacity];
+    quint64 written = 0;
+    quint64 lineStart = 0;
+};
+
+struct InstallProgress {
+    enum Phase { Preparing, Downloading, Installing, Finished };
+
+    Phase phase = Preparing;
+    int total = 0;          // packages to install, 0 if not known yet
+    int downloaded = 0;
+    int installed = 0;
+    int percent = 0;        // overall, downloads counting for the first half
+    QByteArray package;     // the one being worked on
+};
+
+// Follows the install output line by line through a fixed ring, so memory
+// use stays flat however much the package manager prints.
+class InstallProgressParser {
+public:
+    InstallProgressParser(InstallFormat format, int expectedTotal) : format(format) {
+        progress.total = expectedTotal;
+    }
+
+    // True if the progress changed
+    bool feed(const QByteArray &chunk) {
+        bool changed = false;
+        output.feed(std::string_view(chunk.constData(), std::size_t(chunk.size())),
+                    [this, &changed](std::string_view line) { changed |= parseLine(line); });
+        return changed;
+    }
+
+    bool finish() {
+        bool changed = false;
+        output.finish([this, &changed](std::string_view line) { changed |= parseLine(line); });
+        return changed;
+    }
+
+    const InstallProgress &result() const { return progress; }
+    QByteArray tail(int lines) const { return output.tail(lines); }
+
+private:
+    static QByteArray bytes(std::string_view s) { return QByteArray(s.data(), qsizetype(s.size())); }
+
+    static int number(std::string_view s) {
+        int value = 0;
+        while (!s.empty() && s.front() == ' ') s.remove_prefix(1);
+        std::from_chars(s.data(), s.data() + s.size(), value);
+        return value;
+    }
+
+    bool parseLine(std::string_view line) {
+        InstallProgress before = progress;
+        switch (format) {
+        case InstallFormat::Pacman: parsePacman(line); break;
+        case InstallFormat::Apt: parseApt(line); break;
+        case InstallFormat::Pkcon: parsePkcon(line); break;
+        }
+        if (format == InstallFormat::Pacman) updatePercent();
+        return progress.phase != before.phase || progress.percent != before.percent || progress.package != before.package ||
+               progress.installed != before.installed || progress.downloaded != before.downloaded;
+    }
+
+    // pacman reports no percentage without its progress bars; counts stand in
+    void updatePercent() {
+        if (progress.total <= 0) return;
+        int half = progress.phase == InstallProgress::Installing
+                       ? 50 + 50 * std::min(progress.installed, progress.total) / progress.total
+                       : 50 * std::min(progress.downloaded, progress.total) / progress.total;
+        progress.percent = std::max(progress.percent, half);
+    }
+
+    void parsePacman(std::string_view line) {
+        constexpr std::string_view packages = "Packages (";
+        constexpr std::string_view downloading = " downloading...";
+        constexpr std::string_view ellipsis = "...";
+
+        if (line.starts_with(packages)) {
+            progress.total = number(line.substr(packages.size()));
+        } else if (line.starts_with(":: Retrieving packages")) {
+            progress.phase = InstallProgress::Downloading;
+        } else if (line.starts_with(":: Processing package changes")) {
+            progress.phase = InstallProgress::Installing;
+        } else if (line.ends_with(downloading)) {
+            // The databases synced by -y come before the packages
+            std::string_view name = line.substr(0, line.size() - downloading.size());
+            while (!name.empty() && name.front() == ' ') name.remove_prefix(1);
+            progress.package = bytes(name);
+            if (progress.phase == InstallProgress::Downloading) ++progress.downloaded;
+        } else if (line.ends_with(ellipsis)) {
+            for (std::string_view verb : { "upgrading ", "installing ", "reinstalling ", "downgrading " }) {
+                if (!line.starts_with(verb)) continue;
+                progress.phase = InstallProgress::Installing;
+                progress.package = bytes(line.substr(verb.size(), line.size() - verb.size() - ellipsis.size()));
+                ++progress.installed;
+                break;
+            }
+        }
+    }
+
+    // pmstatus:<package>:<percent>:<description> from dpkg and
+    // dlstatus:<item>:<percent>:<description> from the downloads, whose
+    // first field only counts items and whose description reads "Retrieving
+    // file n of m"; the percentage is overall for each
+    void parseApt(std::string_view line) {
+        bool download = line.starts_with("dlstatus:");
+        if (!download && !line.starts_with("pmstatus:")) return;
+
+        std::string_view rest = line.substr(9);
+        std::size_t colon = rest.find(':');
+        if (colon == std::string_view::npos) return;
+        std::string_view name = download ? std::string_view() : rest.substr(0, colon);
+        double percent = 0;
+        rest.remove_prefix(colon + 1);
+        std::from_chars(rest.data(), rest.data() + rest.size(), percent);
+
+        progress.phase = download ? InstallProgress::Downloading : InstallProgress::Installing;
+        progress.percent = std::max(progress.percent, int(percent / 2) + (download ? 0 : 50));
+        if (!name.empty()) progress.package = bytes(name);
+        int done = progress.total > 0 ? int(percent * progress.total / 100) : 0;
+        if (download) progress.downloaded = done;
+        else progress.installed = done;
+    }
+
+    void parsePkcon(std::string_view line) {
+        std::size_t tab = line.find('\t');
+        if (tab == std::string_view::npos) return;
+        std::string_view key = line.substr(0, tab);
+        std::string_view value = line.substr(tab + 1);
+        while (!value.empty() && value.front() == ' ') value.remove_prefix(1);
+
+        if (key == "Percentage:") {
+            progress.percent = std::clamp(number(value), 0, 100);
+        } else if (key == "Status:") {
+            if (value.starts_with("Downloading")) progress.phase = InstallProgress::Downloading;
+            else if (value.starts_with("Installing") || value.starts_with("Updating")) progress.phase = InstallProgress::Installing;
+        } else if (key == "Downloading") {
+            progress.package = bytes(value);
+            ++progress.downloaded;
+        } else if (key == "Installing" || key == "Updating") {
+            progress.package = bytes(value);
+            ++progress.installed;
+        }
+    }
+
+    InstallFormat format;
+    InstallProgress progress;
+    OutputRing<16384> output;
+};
+
+#endif // INSTALLPROGRESS_H
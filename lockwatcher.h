@@ -0,0 +1,81 @@
+#ifndef LOCKWATCHER_H
+#define LOCKWATCHER_H
+
+#include <QByteArray>
+#include <QFile>
+#include <QFileInfo>
+#include <QObject>
+#include <QSocketNotifier>
+#include <QString>
+
+#include <sys/inotify.h>
+#include <unistd.h>
+
+// Tells when a package manager may have let go of its lock. pacman deletes
+// db.lck, while dpkg and apt keep lock-frontend around and only close it,
+// which QFileSystemWatcher does not report. The directory holding the lock
+// is therefore watched with inotify for the lock file being closed after
+// writing (both open it read-write), deleted or moved away. Read-only
+// opens are not reported. released()
+// only means the lock is worth testing again.
+class LockWatcher : public QObject {
+    Q_OBJECT
+public:
+    LockWatcher(QObject *parent = nullptr) : QObject(parent) {}
+
+    ~LockWatcher() { stop(); }
+
+    bool watch(const QString &lockFile) {
+        stop();
+
+        QFileInfo info(lockFile);
+        fd = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (fd < 0) return false;
+
+        QByteArray dir = QFile::encodeName(info.absolutePath());
+        if (::inotify_add_watch(fd, dir.constData(), IN_CLOSE_WRITE | IN_DELETE | IN_MOVED_FROM) < 0) {
+            stop();
+            return false;
+        }
+        lockName = QFile::encodeName(info.fileName());
+
+        notifier = new QSocketNotifier(fd, QSocketNotifier::Read, this);
+        connect(notifier, &QSocketNotifier::activated, this, &LockWatcher::readEvents);
+        return true;
+    }
+
+    void stop() {
+        delete notifier;
+        notifier = nullptr;
+        if (fd >= 0) ::close(fd);
+        fd = -1;
+    }
+
+    bool isWatching() const { return fd >= 0; }
+
+signals:
+    void released();
+
+private slots:
+    void readEvents() {
+        alignas(struct inotify_event) char buffer[4096];
+        bool matched = false;
+
+        ssize_t length;
+        while ((length = ::read(fd, buffer, sizeof(buffer))) > 0) {
+            for (char *p = buffer; p < buffer + length;) {
+                auto *event = reinterpret_cast<struct inotify_event *>(p);
+                if (event->len && lockName == event->name) matched = true;
+                p += sizeof(struct inotify_event) + event->len;
+            }
+        }
+        if (matched) emit released();
+    }
+
+private:
+    int fd = -1;
+    QSocketNotifier *notifier = nullptr;
+    QByteArray lockName;
+};
+
+#endif // LOCKWATCHER_H
@@ -14,10 +14,34 @@
 #include <QLabel>
 #include <QPushButton>
 #include <QTextEdit>
+#include <QLineEdit>
+#include <QTableView>
+#include <QHeaderView>
 #include <QHBoxLayout>
 #include <QStyle>
-#include <QPainter>
 #include <QFontDatabase>
+#include <QFileDialog>
+#include <QElapsedTimer>
+#include <QCommandLineParser>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QTextStream>
+
+#include <algorithm>
+#include <cstdio>
+#include <memory>
+
+#include "backend.h"
+#include "checkscheduler.h"
+#include "diagnostics.h"
+#include "installprogress.h"
+#include "sources.h"
+#include "trayicon.h"
+#include "updateengine.h"
+#include "updatemodel.h"
+#include "updaterecord.h"
+#include "updateservice.h"
 
 class CountdownDialog : public QDialog {
     Q_OBJECT
@@ -121,20 +145,19 @@ class UpdateChecker : public QSystemTrayIcon {
     Q_OBJECT
 public:
     UpdateChecker(QObject *parent = nullptr) : QSystemTrayIcon(parent), updatesAvailable(false) {
-        // Set SVG icons (only using the original three)
-        noUpdatesIcon = QIcon(":/images/no-updates.svg");
-        updatesAvailableIcon = QIcon(":/images/updates.svg");
-        updatedIcon = QIcon(":/images/updated.svg");
-
         // Set initial icon
-        setIcon(noUpdatesIcon);
+        setIcon(trayIcons.icon(TrayIconRenderer::NoUpdates));
         setToolTip("Update Checker - No updates available");
 
         // Create context menu
         menu = new QMenu();
 
         checkAction = menu->addAction("Check for updates");
-        connect(checkAction, &QAction::triggered, this, &UpdateChecker::checkForUpdates);
+        connect(checkAction, &QAction::triggered, this, [this]() { requestCheck(CheckScheduler::Trigger::Manual); });
+
+        cancelCheckAction = menu->addAction("Cancel update check");
+        cancelCheckAction->setVisible(false);
+        connect(cancelCheckAction, &QAction::triggered, this, &UpdateChecker::cancelCheck);
 
         listAction = menu->addAction("List available updates");
         listAction->setEnabled(false);
@@ -149,6 +172,9 @@ public:
         QAction *configAction = menu->addAction("Configuration");
         connect(configAction, &QAction::triggered, this, &UpdateChecker::showConfig);
 
+        QAction *diagnosticsAction = menu->addAction("Diagnostics");
+        connect(diagnosticsAction, &QAction::triggered, this, &UpdateChecker::showDiagnostics);
+
         menu->addSeparator();
 
         QAction *aboutAction = menu->addAction("About");
@@ -161,109 +187,155 @@ public:
 
         setContextMenu(menu);
 
+        prefetcher = new Prefetcher(this);
+        connect(prefetcher, &Prefetcher::finished, this, &UpdateChecker::onPrefetchFinished);
+
         // Load configuration
         loadConfig();
 
-        // Check for updates on first launch
-        QTimer::singleShot(1000, this, &UpdateChecker::checkForUpdates);
+        // Checks run in the update daemon when one is up and here otherwise
+        if (UpdateService::isRunning()) {
+            useServiceClient();
+        } else {
+            useLocalEngine();
+        }
 
-        // Set up periodic checks if enabled
-        if (autoCheckEnabled) {
-            autoCheckTimer = new QTimer(this);
-            connect(autoCheckTimer, &QTimer::timeout, this, &UpdateChecker::checkForUpdates);
-            autoCheckTimer->start(autoCheckInterval * 60 * 1000);
+        if (!backend.isSupported()) {
+            QTimer::singleShot(1000, this, [this]() {
+                showMessage("Error", "Unsupported distribution", QSystemTrayIcon::Warning, 5000);
+            });
         }
 
-        // Initialize dialogs
-        countdownDialog = new CountdownDialog();
-        updateCompleteDialog = new UpdateCompleteDialog();
+        // Dialogs are built on first use and dropped again once idle
+        idleTimer = new QTimer(this);
+        idleTimer->setSingleShot(true);
+        idleTimer->setInterval(IdleReleaseMs);
+        connect(idleTimer, &QTimer::timeout, this, &UpdateChecker::releaseIdleResources);
     }
 
-private slots:
-    void checkForUpdates() {
-        currentDistro = detectDistribution();
-        QString command;
-        QStringList args;
+    // Called once the event loop runs and the icon is up; `clock` started
+    // with the process
+    void recordStartup(const QElapsedTimer &clock) {
+        DiagnosticSample sample;
+        sample.operation = "startup";
+        sample.detail = "tray";
+        sample.addPhase("icon", clock.nsecsElapsed());
+        sample.addCounter("rss_kb", residentSetKb());
+        provider->diagnostics().record(sample);
+    }
 
-        if (currentDistro == "arch" || currentDistro == "cachyos") {
-            command = "checkupdates";
-        }
-        else if (currentDistro == "ubuntu" || currentDistro == "debian") {
-            command = "apt";
-            args << "list" << "--upgradable";
-        }
-        else if (currentDistro == "neon") {
-            command = "pkcon";
-            args << "get-updates";
-        }
-        else {
-            showMessage("Error", "Unsupported distribution", QSystemTrayIcon::Warning, 5000);
+private slots:
+    void requestCheck(CheckScheduler::Trigger trigger) {
+        if (!backend.isSupported()) {
+            // Said once at startup and whenever asked
+            if (trigger == CheckScheduler::Trigger::Manual) {
+                showMessage("Error", "Unsupported distribution", QSystemTrayIcon::Warning, 5000);
+            }
             return;
         }
+        provider->requestCheck(trigger);
+    }
 
-        QProcess process;
-        process.start(command, args);
-        process.waitForFinished();
+    void cancelCheck() {
+        provider->cancelCheck();
+    }
 
-        QString output = process.readAllStandardOutput();
-        QString error = process.readAllStandardError();
+    void onCheckStarted() {
+        checkAction->setEnabled(false);
+        cancelCheckAction->setVisible(true);
+        setToolTip("Update Checker - Checking for updates...");
+    }
 
-        if ((currentDistro == "ubuntu" || currentDistro == "debian") &&
-            error.contains("WARNING: apt does not have a stable CLI interface")) {
-            error.clear();
-            }
+    void onWaitingForLock(int msec) {
+        checkAction->setEnabled(false);
+        cancelCheckAction->setVisible(true);
+        setToolTip(QString("Update Checker - Waiting for %1 to finish (retry in %2 s)...")
+                   .arg(backend.name()).arg((msec + 999) / 1000));
+    }
 
-            if (!error.isEmpty()) {
-                showMessage("Error", "Update check failed: " + error, QSystemTrayIcon::Critical, 5000);
-                return;
-            }
+    void onCheckCanceled() {
+        checkAction->setEnabled(true);
+        cancelCheckAction->setVisible(false);
+        refreshToolTip();
+    }
 
-            if (output.trimmed().isEmpty() ||
-                ((currentDistro == "ubuntu" || currentDistro == "debian") && output.startsWith("Listing..."))) {
-                // No updates available
-                updatesAvailable = false;
-            availableUpdates.clear();
-            setIcon(noUpdatesIcon);
-            setToolTip("Update Checker - System up to date");
-            listAction->setEnabled(false);
-            updateAction->setEnabled(false);
+    void onCheckFinished(const QString &error) {
+        checkAction->setEnabled(true);
+        cancelCheckAction->setVisible(false);
+        refreshToolTip();
 
+        if (!error.isEmpty()) {
+            showMessage("Error", "Update check failed: " + error, QSystemTrayIcon::Critical, 5000);
+        }
+
+        // Whatever the check drew is not needed until the next one
+        if (!isBusy()) releaseWhenIdle();
+    }
+
+    // Only a changed set of pending updates touches the icon, menu and
+    // prompts
+    void onUpdatesChanged(const UpdateDelta &delta, bool announce) {
+        updatesAvailable = !provider->updates().isEmpty();
+        setIcon(currentIcon());
+        refreshToolTip();
+        listAction->setEnabled(updatesAvailable);
+        updateAction->setEnabled(updatesAvailable);
+        if (!announce) return;
+
+        if (!updatesAvailable) {
             if (showNoUpdatesNotification) {
                 showMessage("Update Checker", "System is up to date", QSystemTrayIcon::Information, 3000);
             }
-                } else {
-                    // Updates available
-                    updatesAvailable = true;
-                    availableUpdates = output;
-                    updateCount = output.count('\n');
-                    if (currentDistro == "ubuntu" || currentDistro == "debian") updateCount--;
-
-                    setIcon(updatesAvailableIcon);
-                    setToolTip(QString("Update Checker - %1 updates available").arg(updateCount));
-                    listAction->setEnabled(true);
-                    updateAction->setEnabled(true);
+            return;
+        }
 
-                    if (showUpdatesNotification) {
-                        showUpdatePrompt();
-                    }
-                }
+        // Updates that merely went away since the last prompt need none
+        if (showUpdatesNotification && delta.hasNewUpdates()) {
+            showUpdatePrompt();
+        }
+        if (delta.hasNewUpdates()) startPrefetch();
     }
 
     void listUpdates() {
         QDialog listDialog;
-        listDialog.setWindowTitle(QString("Available Updates (%1 packages)").arg(updateCount));
+        listDialog.setWindowTitle(QString("Available Updates (%1 packages)").arg(provider->count()));
         listDialog.resize(600, 400);
 
         QVBoxLayout *layout = new QVBoxLayout(&listDialog);
 
-        QTextEdit *textEdit = new QTextEdit(&listDialog);
-        textEdit->setPlainText(availableUpdates);
-        textEdit->setReadOnly(true);
-        textEdit->setLineWrapMode(QTextEdit::NoWrap);
+        QLineEdit *searchEdit = new QLineEdit(&listDialog);
+        searchEdit->setPlaceholderText("Search packages");
+        searchEdit->setClearButtonEnabled(true);
+
+        // Rows are only laid out and decoded as they scroll into view
+        UpdateTableModel *model = new UpdateTableModel(provider->updates(), &listDialog);
+        QTableView *tableView = new QTableView(&listDialog);
+        tableView->setModel(model);
+        tableView->setSortingEnabled(true);
+        tableView->horizontalHeader()->setSortIndicator(-1, Qt::AscendingOrder);
+        tableView->horizontalHeader()->setStretchLastSection(true);
+        tableView->verticalHeader()->setSectionResizeMode(QHeaderView::Fixed);
+        tableView->verticalHeader()->setDefaultSectionSize(tableView->fontMetrics().height() + 6);
+        tableView->verticalHeader()->hide();
+        tableView->setSelectionBehavior(QAbstractItemView::SelectRows);
+        tableView->setEditTriggers(QAbstractItemView::NoEditTriggers);
+        tableView->setWordWrap(false);
+        tableView->setColumnWidth(UpdateTableModel::Name, 200);
+        if (prefetchEnabled) {
+            model->setStaged(stagedUpdates());
+        } else {
+            tableView->setColumnHidden(UpdateTableModel::Staged, true);
+        }
+        tableView->setColumnHidden(UpdateTableModel::Source, !provider->hasExtraUpdates());
 
-        QFont font = textEdit->font();
+        QFont font = tableView->font();
         font.setFamily("Monospace");
-        textEdit->setFont(font);
+        tableView->setFont(font);
+
+        connect(searchEdit, &QLineEdit::textChanged, model, &UpdateTableModel::setFilter);
+        connect(model, &UpdateTableModel::filtered, &listDialog, [&listDialog, this](int rows) {
+            listDialog.setWindowTitle(QString("Available Updates (%1 of %2 packages)").arg(rows).arg(provider->count()));
+        });
 
         QHBoxLayout *buttonLayout = new QHBoxLayout();
         QPushButton *installButton = new QPushButton("Install Updates", &listDialog);
@@ -281,63 +353,121 @@ private slots:
         buttonLayout->addWidget(closeButton);
 
         layout->addWidget(new QLabel("The following updates are available:"));
-        layout->addWidget(textEdit);
+        layout->addWidget(searchEdit);
+        layout->addWidget(tableView);
         layout->addLayout(buttonLayout);
 
         listDialog.exec();
     }
 
     void installUpdates() {
-        QString command;
-        QStringList args;
+        // One install at a time
+        if (terminalProcess || installProcess) return;
 
-        if (currentDistro == "arch" || currentDistro == "cachyos") {
-            command = "konsole";
-            args << "-e" << "sudo" << "pacman" << "-Syu";
-        }
-        else if (currentDistro == "ubuntu" || currentDistro == "debian") {
-            command = "konsole";
-            args << "-e" << "bash" << "-c" << "sudo apt update && sudo apt upgrade -y";
-        }
-        else if (currentDistro == "neon") {
-            command = "konsole";
-            args << "-e" << "sudo" << "pkcon" << "update" << "-y";
+        // Whatever is staged by now is used; the install fetches the rest
+        prefetcher->cancel();
+
+        if (installInTray) {
+            startTrayInstall();
+            return;
         }
 
+        BackendCommand command = backend.installCommand();
+        if (command.program.isEmpty()) return;
+
         // Start the process and monitor it
+        installTimer.start();
+        installSpawnNs = -1;
         terminalProcess = new QProcess(this);
+        connect(terminalProcess, &QProcess::started, this, [this]() { installSpawnNs = installTimer.nsecsElapsed(); });
         connect(terminalProcess, QOverload<int, QProcess::ExitStatus>::of(&QProcess::finished),
                 this, &UpdateChecker::onTerminalClosed);
 
-        terminalProcess->start(command, args);
+        terminalProcess->start(command.program, command.args);
 
         // Show countdown dialog when updates start installing
+        if (!countdownDialog) {
+            countdownDialog = new CountdownDialog();
+            connect(countdownDialog, &QDialog::finished, this, &UpdateChecker::releaseWhenIdle);
+        }
+        idleTimer->stop();
         countdownDialog->startCountdown();
 
         // Keep the updates available icon during installation
-        setIcon(updatesAvailableIcon);
+        setIcon(trayIcons.icon(TrayIconRenderer::UpdatesAvailable, provider->count()));
         setToolTip("Update Checker - Installing updates...");
     }
 
     void onTerminalClosed(int exitCode, QProcess::ExitStatus exitStatus) {
-        Q_UNUSED(exitCode);
-        Q_UNUSED(exitStatus);
-
         // Clean up the process
         terminalProcess->deleteLater();
         terminalProcess = nullptr;
 
-        // Show update complete dialog
-        updateCompleteDialog->exec();
+        bool ok = exitStatus == QProcess::NormalExit && exitCode == 0;
+        finishInstall(exitCode, ok ? "ok" : "failed", ok ? QString() : QString("The terminal exited with status %1").arg(exitCode));
+    }
 
-        if (updateCompleteDialog->shouldReboot()) {
-            QProcess::startDetached("konsole", QStringList() << "-e" << "sudo" << "reboot");
-        }
+    // Runs the package manager without a terminal, authorized through
+    // polkit, and follows its output to show progress in the tray
+    void startTrayInstall() {
+        BackendCommand command = backend.trayInstallCommand();
+        if (command.program.isEmpty()) return;
+
+        installTimer.start();
+        installSpawnNs = -1;
+        installParser = std::make_unique<InstallProgressParser>(backend.installFormat(), provider->systemCount());
+
+        installProcess = new QProcess(this);
+        installProcess->setProcessChannelMode(QProcess::MergedChannels);
+        connect(installProcess, &QProcess::started, this, [this]() { installSpawnNs = installTimer.nsecsElapsed(); });
+        connect(installProcess, &QProcess::readyReadStandardOutput, this, &UpdateChecker::onInstallOutput);
+        connect(installProcess, QOverload<int, QProcess::ExitStatus>::of(&QProcess::finished),
+                this, &UpdateChecker::onInstallFinished);
+        connect(installProcess, &QProcess::errorOccurred, this, [this](QProcess::ProcessError error) {
+            if (error == QProcess::FailedToStart) onInstallFinished(-1, QProcess::CrashExit);
+        });
 
-        // Check for updates again after terminal closes
-        checkForUpdates();
+        updateAction->setEnabled(false);
+        checkAction->setEnabled(false);
+        showInstallProgress();
+
+        installProcess->start(command.program, command.args);
+    }
+
+    void onInstallOutput() {
+        if (installParser->feed(installProcess->readAllStandardOutput())) showInstallProgress();
     }
 
+    void onInstallFinished(int exitCode, QProcess::ExitStatus exitStatus) {
+        if (!installProcess) return;
+
+        QProcess *done = installProcess;
+        installProcess = nullptr;
+        done->disconnect(this);
+        installParser->feed(done->readAllStandardOutput());
+        installParser->finish();
+        QString startError = done->error() == QProcess::FailedToStart ? done->errorString() : QString();
+        done->deleteLater();
+
+        checkAction->setEnabled(true);
+
+        // pkexec exits with 126 when authorization is dismissed or denied
+        QString failure;
+        if (!startError.isEmpty()) {
+            failure = "Failed to start " + backend.trayInstallCommand().program + ": " + startError;
+        } else if (exitStatus == QProcess::CrashExit) {
+            failure = "The package manager terminated unexpectedly";
+        } else if (exitCode == 126 || exitCode == 127) {
+            failure = "Authorization was not granted";
+        } else if (exitCode != 0) {
+            failure = QString("The package manager exited with status %1:\n").arg(exitCode) +
+                      QString::fromUtf8(installParser->tail(5));
+        }
+
+        int installed = installParser->result().installed;
+        installParser.reset();
+        finishInstall(exitCode, failure.isEmpty() ? "ok" : "failed", failure, installed);
+    }
     void showConfig() {
         QDialog configDialog;
         configDialog.setWindowTitle("Update Checker Configuration");
@@ -345,13 +475,75 @@ private slots:
         QVBoxLayout *layout = new QVBoxLayout(&configDialog);
 
         QCheckBox *autoCheckBox = new QCheckBox("Enable automatic update checking", &configDialog);
-        autoCheckBox->setChecked(autoCheckEnabled);
+        autoCheckBox->setChecked(engineConfig.autoCheckEnabled);
 
         QSpinBox *intervalSpin = new QSpinBox(&configDialog);
         intervalSpin->setRange(15, 1440);
-        intervalSpin->setValue(autoCheckInterval);
+        intervalSpin->setValue(engineConfig.autoCheckInterval);
         intervalSpin->setSuffix(" minutes");
 
+        QCheckBox *watchBox = new QCheckBox("Re-check when the package database changes", &configDialog);
+        watchBox->setChecked(engineConfig.watchDatabases);
+
+        QSpinBox *fallbackSpin = new QSpinBox(&configDialog);
+        fallbackSpin->setRange(60, 10080);
+        fallbackSpin->setValue(engineConfig.fallbackCheckInterval);
+        fallbackSpin->setSuffix(" minutes");
+        fallbackSpin->setEnabled(engineConfig.watchDatabases);
+        connect(watchBox, &QCheckBox::toggled, fallbackSpin, &QSpinBox::setEnabled);
+
+        QCheckBox *nativeBox = new QCheckBox("Read package databases directly instead of running the package manager", &configDialog);
+        nativeBox->setChecked(engineConfig.useNativeCheck);
+        nativeBox->setEnabled(backend.hasNativeCheck());
+
+        QSpinBox *timeoutSpin = new QSpinBox(&configDialog);
+        timeoutSpin->setRange(30, 3600);
+        timeoutSpin->setValue(engineConfig.checkLimits.timeoutSec);
+        timeoutSpin->setSuffix(" seconds");
+
+        QCheckBox *lowPriorityBox = new QCheckBox("Run update checks at idle CPU and disk priority", &configDialog);
+        lowPriorityBox->setChecked(engineConfig.checkLimits.lowPriority);
+
+        QCheckBox *scopeBox = new QCheckBox("Run update checks in a systemd scope with resource limits", &configDialog);
+        scopeBox->setChecked(engineConfig.checkLimits.useScope);
+
+        QSpinBox *cpuQuotaSpin = new QSpinBox(&configDialog);
+        cpuQuotaSpin->setRange(5, 400);
+        cpuQuotaSpin->setValue(engineConfig.checkLimits.cpuQuotaPercent);
+        cpuQuotaSpin->setSuffix("% CPU");
+        cpuQuotaSpin->setEnabled(engineConfig.checkLimits.useScope);
+        connect(scopeBox, &QCheckBox::toggled, cpuQuotaSpin, &QSpinBox::setEnabled);
+
+        QSpinBox *memoryMaxSpin = new QSpinBox(&configDialog);
+        memoryMaxSpin->setRange(64, 16384);
+        memoryMaxSpin->setValue(engineConfig.checkLimits.memoryMaxMb);
+        memoryMaxSpin->setSuffix(" MB memory");
+        memoryMaxSpin->setEnabled(engineConfig.checkLimits.useScope);
+        connect(scopeBox, &QCheckBox::toggled, memoryMaxSpin, &QSpinBox::setEnabled);
+
+        QCheckBox *trayInstallBox = new QCheckBox("Install updates in the background with progress in the tray", &configDialog);
+        trayInstallBox->setChecked(installInTray);
+
+        QCheckBox *prefetchBox = new QCheckBox("Download updates in the background before installing", &configDialog);
+        prefetchBox->setChecked(prefetchEnabled);
+        prefetchBox->setEnabled(backend.isSupported());
+
+        QSpinBox *rateLimitSpin = new QSpinBox(&configDialog);
+        rateLimitSpin->setRange(0, 1000000);
+        rateLimitSpin->setValue(prefetchRateLimit);
+        rateLimitSpin->setSuffix(" KB/s");
+        rateLimitSpin->setSpecialValueText("No limit");
+        rateLimitSpin->setEnabled(prefetchEnabled);
+        connect(prefetchBox, &QCheckBox::toggled, rateLimitSpin, &QSpinBox::setEnabled);
+
+        QList<std::pair<ExtraSource, QCheckBox *>> sourceBoxes;
+        for (const ExtraSource &source : ExtraSource::all()) {
+            QCheckBox *box = new QCheckBox("Also check " + source.title + " (" + source.program + ")", &configDialog);
+            box->setChecked(engineConfig.extraSources.contains(sourceName(source.id)));
+            box->setEnabled(source.isAvailable());
+            sourceBoxes.append({ source, box });
+        }
+
         QCheckBox *notifyUpdatesBox = new QCheckBox("Notify when updates are available", &configDialog);
         notifyUpdatesBox->setChecked(showUpdatesNotification);
 
@@ -364,119 +556,384 @@ private slots:
         layout->addWidget(autoCheckBox);
         layout->addWidget(new QLabel("Check interval:"));
         layout->addWidget(intervalSpin);
+        layout->addWidget(watchBox);
+        layout->addWidget(new QLabel("Fallback check interval while watching:"));
+        layout->addWidget(fallbackSpin);
+        layout->addWidget(nativeBox);
+        layout->addWidget(new QLabel("Stop update checks after:"));
+        layout->addWidget(timeoutSpin);
+        layout->addWidget(lowPriorityBox);
+        layout->addWidget(scopeBox);
+        layout->addWidget(cpuQuotaSpin);
+        layout->addWidget(memoryMaxSpin);
+        layout->addWidget(trayInstallBox);
+        layout->addWidget(prefetchBox);
+        layout->addWidget(new QLabel("Background download limit:"));
+        layout->addWidget(rateLimitSpin);
+        for (const auto &sourceBox : sourceBoxes) layout->addWidget(sourceBox.second);
         layout->addWidget(notifyUpdatesBox);
         layout->addWidget(notifyNoUpdatesBox);
         layout->addWidget(saveButton);
 
         connect(saveButton, &QPushButton::clicked, [&]() {
-            autoCheckEnabled = autoCheckBox->isChecked();
-            autoCheckInterval = intervalSpin->value();
+            engineConfig.autoCheckEnabled = autoCheckBox->isChecked();
+            engineConfig.autoCheckInterval = intervalSpin->value();
+            engineConfig.watchDatabases = watchBox->isChecked();
+            engineConfig.fallbackCheckInterval = fallbackSpin->value();
+            engineConfig.useNativeCheck = nativeBox->isChecked();
+            engineConfig.checkLimits.timeoutSec = timeoutSpin->value();
+            engineConfig.checkLimits.lowPriority = lowPriorityBox->isChecked();
+            engineConfig.checkLimits.useScope = scopeBox->isChecked();
+            engineConfig.checkLimits.cpuQuotaPercent = cpuQuotaSpin->value();
+            engineConfig.checkLimits.memoryMaxMb = memoryMaxSpin->value();
+            installInTray = trayInstallBox->isChecked();
+            prefetchEnabled = prefetchBox->isChecked();
+            prefetchRateLimit = rateLimitSpin->value();
+            if (!prefetchEnabled) prefetcher->cancel();
+            engineConfig.extraSources.clear();
+            for (const auto &sourceBox : sourceBoxes) {
+                if (sourceBox.second->isChecked()) engineConfig.extraSources.append(sourceName(sourceBox.first.id));
+            }
             showUpdatesNotification = notifyUpdatesBox->isChecked();
             showNoUpdatesNotification = notifyNoUpdatesBox->isChecked();
 
-            if (autoCheckTimer) {
-                autoCheckTimer->stop();
-                if (autoCheckEnabled) {
-                    autoCheckTimer->start(autoCheckInterval * 60 * 1000);
-                }
-            } else if (autoCheckEnabled) {
-                autoCheckTimer = new QTimer(this);
-                connect(autoCheckTimer, &QTimer::timeout, this, &UpdateChecker::checkForUpdates);
-                autoCheckTimer->start(autoCheckInterval * 60 * 1000);
-            }
-
+            // Saved first: the update daemon reads the settings back
             saveConfig();
+            provider->setConfig(engineConfig);
             configDialog.accept();
         });
 
         configDialog.exec();
     }
 
-private:
-    void showUpdatePrompt() {
-        QDialog *promptDialog = new QDialog();  // Changed to pointer to keep it alive
-        promptDialog->setWindowTitle("Updates Available");
-        promptDialog->setFixedSize(400, 200);
+    void showDiagnostics() {
+        QDialog diagnosticsDialog;
+        diagnosticsDialog.setWindowTitle("Update Checker - Diagnostics");
+        diagnosticsDialog.resize(700, 400);
 
-        QVBoxLayout *layout = new QVBoxLayout(promptDialog);
+        QVBoxLayout *layout = new QVBoxLayout(&diagnosticsDialog);
 
-        QLabel *messageLabel = new QLabel(QString("%1 updates are available").arg(updateCount), promptDialog);
-        messageLabel->setAlignment(Qt::AlignCenter);
-        messageLabel->setStyleSheet("font-size: 16px; color: #24ffff;");
-        layout->addWidget(messageLabel);
-
-        QHBoxLayout *buttonLayout = new QHBoxLayout();
+        QTextEdit *textEdit = new QTextEdit(&diagnosticsDialog);
+        textEdit->setPlainText(diagnosticsText());
+        textEdit->setReadOnly(true);
+        textEdit->setLineWrapMode(QTextEdit::NoWrap);
 
-        QPushButton *installButton = new QPushButton("Install Now", promptDialog);
-        installButton->setStyleSheet("color: #24ffff;");
-        connect(installButton, &QPushButton::clicked, [this, promptDialog]() {
-            promptDialog->accept();
-            installUpdates();
-            promptDialog->deleteLater();  // Clean up when done
-        });
+        QFont font = textEdit->font();
+        font.setFamily("Monospace");
+        textEdit->setFont(font);
 
-        QPushButton *listButton = new QPushButton("View List", promptDialog);
-        listButton->setStyleSheet("color: #24ffff;");
-        connect(listButton, &QPushButton::clicked, [this, promptDialog]() {
-            promptDialog->accept();
-            listUpdates();
-            promptDialog->deleteLater();  // Clean up when done
+        QHBoxLayout *buttonLayout = new QHBoxLayout();
+        QPushButton *exportButton = new QPushButton("Export...", &diagnosticsDialog);
+        exportButton->setStyleSheet("color: #24ffff;");
+        connect(exportButton, &QPushButton::clicked, [&]() {
+            QString path = QFileDialog::getSaveFileName(&diagnosticsDialog, "Export Diagnostics",
+                                                        QDir::homePath() + "/update-checker-diagnostics.jsonl",
+                                                        "JSON Lines (*.jsonl)");
+            if (path.isEmpty()) return;
+
+            QFile file(path);
+            if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate) || file.write(provider->diagnostics().toJsonLines()) < 0) {
+                QMessageBox::warning(&diagnosticsDialog, "Error", "Cannot write " + path + ": " + file.errorString());
+            }
         });
 
-        QPushButton *laterButton = new QPushButton("Later", promptDialog);
-        laterButton->setStyleSheet("color: #24ffff;");
-        connect(laterButton, &QPushButton::clicked, [promptDialog]() {
-            // Just hide the dialog instead of closing it
-            promptDialog->hide();
-        });
+        QPushButton *closeButton = new QPushButton("Close", &diagnosticsDialog);
+        closeButton->setStyleSheet("color: #24ffff;");
+        connect(closeButton, &QPushButton::clicked, &diagnosticsDialog, &QDialog::accept);
 
-        buttonLayout->addWidget(installButton);
-        buttonLayout->addWidget(listButton);
-        buttonLayout->addWidget(laterButton);
+        buttonLayout->addWidget(exportButton);
+        buttonLayout->addWidget(closeButton);
 
+        layout->addWidget(new QLabel("Recent checks and installs, oldest first:"));
+        layout->addWidget(textEdit);
         layout->addLayout(buttonLayout);
 
-        // Delete dialog when closed
-        connect(promptDialog, &QDialog::finished, promptDialog, &QDialog::deleteLater);
+        diagnosticsDialog.exec();
+    }
 
-        promptDialog->show();
+private:
+    // Runs the checks in this process and offers them to other clients,
+    // unless another process already does
+    void useLocalEngine() {
+        UpdateEngine *engine = new UpdateEngine(this);
+        attachProvider(engine);
+        engine->start(engineConfig);
+
+        new UpdateServiceAdaptor(engine);
+        QDBusConnection bus = QDBusConnection::sessionBus();
+        if (bus.registerObject(UpdateService::Path, engine)) bus.registerService(UpdateService::Name);
+    }
+
+    void useServiceClient() {
+        UpdateServiceClient *client = new UpdateServiceClient(this);
+        connect(client, &UpdateServiceClient::serviceLost, this, [this]() {
+            showMessage("Update Checker", "The update service stopped, checking from the tray instead",
+                        QSystemTrayIcon::Information, 5000);
+            useLocalEngine();
+        });
+        attachProvider(client);
     }
 
-    QString detectDistribution() {
-        if (QFile::exists("/etc/arch-release")) {
-            QFile osRelease("/etc/os-release");
-            if (osRelease.open(QIODevice::ReadOnly)) {
-                QString content = osRelease.readAll();
-                if (content.contains("CachyOS")) {
-                    return "cachyos";
-                }
+    void attachProvider(UpdateProvider *newProvider) {
+        if (provider) provider->deleteLater();
+        provider = newProvider;
+        backend = provider->backend();
+
+        connect(provider, &UpdateProvider::checkStarted, this, &UpdateChecker::onCheckStarted);
+        connect(provider, &UpdateProvider::waitingForLock, this, &UpdateChecker::onWaitingForLock);
+        connect(provider, &UpdateProvider::checkCanceled, this, &UpdateChecker::onCheckCanceled);
+        connect(provider, &UpdateProvider::checkFinished, this, &UpdateChecker::onCheckFinished);
+        connect(provider, &UpdateProvider::updatesChanged, this, &UpdateChecker::onUpdatesChanged);
+    }
+
+    void finishInstall(int exitCode, const QString &result, const QString &failure, int installed = -1) {
+        DiagnosticSample sample;
+        sample.operation = "install";
+        sample.detail = backend.name() + (installInTray ? " (tray)" : " (terminal)");
+        sample.result = result;
+        sample.addPhase("spawn", installSpawnNs);
+        sample.addPhase("total", installTimer.nsecsElapsed());
+        sample.addCounter("exit_code", exitCode);
+        if (installed >= 0) sample.addCounter("packages", installed);
+        provider->diagnostics().record(sample);
+
+        InstallProgress done;
+        done.phase = InstallProgress::Finished;
+        done.percent = failure.isEmpty() ? 100 : 0;
+        done.installed = std::max(installed, 0);
+        provider->reportInstallProgress(done);
+
+        if (failure.isEmpty()) {
+            // Staged packages are installed now
+            QDir(Prefetch::stagingDir(backend.name())).removeRecursively();
+
+            // Show update complete dialog
+            if (!updateCompleteDialog) updateCompleteDialog = new UpdateCompleteDialog();
+            idleTimer->stop();
+            updateCompleteDialog->exec();
+
+            if (updateCompleteDialog->shouldReboot()) {
+                QProcess::startDetached("konsole", QStringList() << "-e" << "sudo" << "reboot");
             }
-            return "arch";
+            releaseWhenIdle();
+        } else {
+            showMessage("Error", "Installing updates failed: " + failure, QSystemTrayIcon::Critical, 10000);
         }
-        if (QFile::exists("/etc/debian_version")) {
-            QFile osRelease("/etc/os-release");
-            if (osRelease.open(QIODevice::ReadOnly)) {
-                QString content = osRelease.readAll();
-                if (content.contains("KDE neon")) return "neon";
-                if (content.contains("Ubuntu")) return "ubuntu";
+
+        // Check for updates again after the install
+        setIcon(failure.isEmpty() ? trayIcons.icon(TrayIconRenderer::Updated) : currentIcon());
+        refreshToolTip();
+        requestCheck(CheckScheduler::Trigger::AfterInstall);
+    }
+
+    // Downloads the pending packages in the background so the install
+    // only has to unpack them
+    void startPrefetch() {
+        if (!prefetchEnabled || terminalProcess || installProcess) return;
+
+        PrefetchOptions options;
+        options.stagingDir = Prefetch::stagingDir(backend.name());
+        options.rateLimitKb = prefetchRateLimit;
+
+        BackendCommand command = backend.prefetchCommand(options);
+        if (command.program.isEmpty()) return;
+        prefetcher->start(command.program, command.args);
+    }
+
+    void onPrefetchFinished(int exitCode, const QByteArray &output, qint64 elapsedMs) {
+        QVector<bool> staged = stagedUpdates();
+
+        DiagnosticSample sample;
+        sample.operation = "prefetch";
+        sample.detail = backend.name();
+        sample.result = exitCode == 0 ? QString("ok") : "error: " + QString::fromUtf8(output.split('\n').last());
+        sample.addPhase("total", elapsedMs * 1000000);
+        sample.addCounter("exit_code", exitCode);
+        sample.addCounter("staged", std::count(staged.begin(), staged.end(), true));
+        sample.addCounter("pending", provider->count());
+
+        qint64 bytes = 0;
+        const QFileInfoList files = QDir(Prefetch::stagingDir(backend.name())).entryInfoList(QDir::Files);
+        for (const QFileInfo &file : files) bytes += file.size();
+        sample.addCounter("staged_bytes", bytes);
+        provider->diagnostics().record(sample);
+    }
+
+    // One flag per pending update telling whether its package is staged
+    QVector<bool> stagedUpdates() const {
+        QStringList files = QDir(Prefetch::stagingDir(backend.name())).entryList(QDir::Files, QDir::Name);
+        files.erase(std::remove_if(files.begin(), files.end(),
+                                   [](const QString &file) { return file.endsWith(".part") || file.endsWith(".sig"); }),
+                    files.end());
+
+        const UpdateList &updates = provider->updates();
+        QVector<bool> staged(updates.count(), false);
+        for (int i = 0; i < updates.count(); ++i) {
+            const UpdateRecord &record = updates.at(i);
+            if (record.source != UpdateSource::System) continue;
+            QByteArray prefix = backend.stagedPrefix(updates.text(record.name).toUtf8(),
+                                                     updates.text(record.newVersion).toUtf8());
+            if (prefix.isEmpty()) continue;
+
+            // The files are sorted, so a match is right at the lower bound
+            QString wanted = QString::fromUtf8(prefix);
+            auto it = std::lower_bound(files.cbegin(), files.cend(), wanted);
+            staged[i] = it != files.cend() && it->startsWith(wanted);
+        }
+        return staged;
+    }
+
+    void showInstallProgress() {
+        const InstallProgress &progress = installParser->result();
+
+        QString text = QString("Update Checker - Installing updates: %1%").arg(progress.percent);
+        int count = progress.phase == InstallProgress::Installing ? progress.installed : progress.downloaded;
+        if (progress.phase != InstallProgress::Preparing) {
+            text += progress.phase == InstallProgress::Installing ? "\nInstalling " : "\nDownloading ";
+            if (progress.total > 0) text += QString("%1/%2 ").arg(count).arg(progress.total);
+            text += QString::fromUtf8(progress.package);
+
+            double minutes = installTimer.elapsed() / 60000.0;
+            if (count > 0 && minutes > 0) text += QString(" (%1 packages/min)").arg(count / minutes, 0, 'f', 1);
+        }
+        setToolTip(text);
+        setIcon(trayIcons.icon(TrayIconRenderer::Installing, provider->count(), progress.percent));
+        provider->reportInstallProgress(progress);
+    }
+
+    QIcon currentIcon() {
+        return updatesAvailable ? trayIcons.icon(TrayIconRenderer::UpdatesAvailable, provider->count())
+                                : trayIcons.icon(TrayIconRenderer::NoUpdates);
+    }
+
+    QString diagnosticsText() const {
+        QString text;
+        for (const DiagnosticSample &sample : provider->diagnostics().samples()) {
+            text += sample.timestamp.toString("yyyy-MM-dd hh:mm:ss") + "  " + sample.operation;
+            if (!sample.detail.isEmpty()) text += " [" + sample.detail + ']';
+            text += "  " + sample.result + '\n';
+            for (const auto &phase : sample.phasesNs) {
+                text += QString("    %1 %2 ms\n").arg(phase.first, -12).arg(phase.second / 1e6, 0, 'f', 2);
             }
-            return "debian";
+            for (const auto &counter : sample.counters) {
+                text += QString("    %1 %2\n").arg(counter.first, -12).arg(counter.second);
+            }
+        }
+        return text.isEmpty() ? QString("Nothing recorded yet\n") : text;
+    }
+
+    void refreshToolTip() {
+        if (updatesAvailable) {
+            setToolTip(QString("Update Checker - %1 updates available").arg(provider->count()));
+        } else {
+            setToolTip("Update Checker - System up to date");
+        }
+    }
+
+    // Built once and reused; a later check only updates the count
+    void showUpdatePrompt() {
+        if (!promptDialog) {
+            promptDialog = new QDialog();
+            promptDialog->setWindowTitle("Updates Available");
+            promptDialog->setFixedSize(400, 200);
+
+            QVBoxLayout *layout = new QVBoxLayout(promptDialog);
+
+            promptLabel = new QLabel(promptDialog);
+            promptLabel->setAlignment(Qt::AlignCenter);
+            promptLabel->setStyleSheet("font-size: 16px; color: #24ffff;");
+            layout->addWidget(promptLabel);
+
+            QHBoxLayout *buttonLayout = new QHBoxLayout();
+
+            QPushButton *installButton = new QPushButton("Install Now", promptDialog);
+            installButton->setStyleSheet("color: #24ffff;");
+            connect(installButton, &QPushButton::clicked, this, [this]() {
+                promptDialog->accept();
+                installUpdates();
+            });
+
+            QPushButton *listButton = new QPushButton("View List", promptDialog);
+            listButton->setStyleSheet("color: #24ffff;");
+            connect(listButton, &QPushButton::clicked, this, [this]() {
+                promptDialog->accept();
+                listUpdates();
+            });
+
+            QPushButton *laterButton = new QPushButton("Later", promptDialog);
+            laterButton->setStyleSheet("color: #24ffff;");
+            connect(laterButton, &QPushButton::clicked, promptDialog, &QDialog::reject);
+
+            buttonLayout->addWidget(installButton);
+            buttonLayout->addWidget(listButton);
+            buttonLayout->addWidget(laterButton);
+
+            layout->addLayout(buttonLayout);
+
+            connect(promptDialog, &QDialog::finished, this, &UpdateChecker::releaseWhenIdle);
         }
-        return "unknown";
+
+        idleTimer->stop();
+        promptLabel->setText(QString("%1 updates are available").arg(provider->count()));
+        promptDialog->show();
+        promptDialog->raise();
+    }
+
+    void releaseWhenIdle() {
+        idleTimer->start();
+    }
+
+    bool isBusy() const {
+        return terminalProcess || installProcess || (promptDialog && promptDialog->isVisible());
+    }
+
+    // Most sessions only ever show the icon; what the dialogs and the icon
+    // caches hold is given back until they are needed again
+    void releaseIdleResources() {
+        // Tried again once the install or prompt is done with
+        if (isBusy()) return;
+
+        qint64 before = residentSetKb();
+
+        auto release = [](auto *&dialog) {
+            if (dialog && !dialog->isVisible()) {
+                delete dialog;
+                dialog = nullptr;
+            }
+        };
+        release(countdownDialog);
+        release(updateCompleteDialog);
+        if (promptDialog && !promptDialog->isVisible()) promptLabel = nullptr;
+        release(promptDialog);
+        trayIcons.release();
+        trimHeap();
+
+        DiagnosticSample sample;
+        sample.operation = "idle";
+        sample.detail = "release";
+        sample.addCounter("rss_before_kb", before);
+        sample.addCounter("rss_kb", residentSetKb());
+        provider->diagnostics().record(sample);
     }
 
     void loadConfig() {
+        engineConfig = EngineConfig::load();
+
         QSettings settings;
-        autoCheckEnabled = settings.value("autoCheckEnabled", true).toBool();
-        autoCheckInterval = settings.value("autoCheckInterval", 60).toInt();
+        installInTray = settings.value("installInTray", false).toBool();
+        prefetchEnabled = settings.value("prefetchEnabled", false).toBool();
+        prefetchRateLimit = settings.value("prefetchRateLimit", 0).toInt();
         showUpdatesNotification = settings.value("showUpdatesNotification", true).toBool();
         showNoUpdatesNotification = settings.value("showNoUpdatesNotification", false).toBool();
     }
 
     void saveConfig() {
+        engineConfig.save();
+
         QSettings settings;
-        settings.setValue("autoCheckEnabled", autoCheckEnabled);
-        settings.setValue("autoCheckInterval", autoCheckInterval);
+        settings.setValue("installInTray", installInTray);
+        settings.setValue("prefetchEnabled", prefetchEnabled);
+        settings.setValue("prefetchRateLimit", prefetchRateLimit);
         settings.setValue("showUpdatesNotification", showUpdatesNotification);
         settings.setValue("showNoUpdatesNotification", showNoUpdatesNotification);
     }
@@ -498,29 +955,169 @@ private:
 
     QMenu *menu;
     QAction *checkAction;
+    QAction *cancelCheckAction;
     QAction *listAction;
     QAction *updateAction;
-    QTimer *autoCheckTimer = nullptr;
     CountdownDialog *countdownDialog = nullptr;
     UpdateCompleteDialog *updateCompleteDialog = nullptr;
+    QDialog *promptDialog = nullptr;
+    QLabel *promptLabel = nullptr;
+    QTimer *idleTimer = nullptr;
+    static constexpr int IdleReleaseMs = 5 * 60 * 1000;
     QProcess *terminalProcess = nullptr;
-    QString currentDistro;
+    QProcess *installProcess = nullptr;
+    std::unique_ptr<InstallProgressParser> installParser;
+    Prefetcher *prefetcher = nullptr;
+    QElapsedTimer installTimer;
+    qint64 installSpawnNs = -1;
+    UpdateProvider *provider = nullptr;
+    UpdateBackend backend;
     bool updatesAvailable;
-    int updateCount;
-    QString availableUpdates;
-    bool autoCheckEnabled;
-    int autoCheckInterval;
+    EngineConfig engineConfig;
+    bool installInTray;
+    bool prefetchEnabled;
+    int prefetchRateLimit;
     bool showUpdatesNotification;
     bool showNoUpdatesNotification;
-    QIcon noUpdatesIcon;
-    QIcon updatesAvailableIcon;
-    QIcon updatedIcon;
+    TrayIconRenderer trayIcons;
 };
 
+// Runs the checks without any UI and offers them on the session bus
+static int runDaemon(int argc, char *argv[]) {
+    QCoreApplication app(argc, argv);
+    app.setApplicationName("Update Checker");
+    app.setOrganizationName("claudemods");
+    UpdateService::registerTypes();
+
+    UpdateEngine engine;
+    new UpdateServiceAdaptor(&engine);
+
+    QDBusConnection bus = QDBusConnection::sessionBus();
+    if (!bus.registerObject(UpdateService::Path, &engine) || !bus.registerService(UpdateService::Name)) {
+        qCritical("Cannot register %s on the session bus: %s", qPrintable(UpdateService::Name),
+                  qPrintable(bus.lastError().message()));
+        return 1;
+    }
+
+    engine.start(EngineConfig::load());
+    return app.exec();
+}
+
+// For scripts and remote shells: prints the pending updates and exits,
+// without widgets, icons or a tray. The saved result is reused while it is
+// current, so this usually ends without running the package manager.
+static int runCli(int argc, char *argv[], const QElapsedTimer &clock) {
+    QCoreApplication app(argc, argv);
+    app.setApplicationName("Update Checker");
+    app.setOrganizationName("claudemods");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Update Checker - prints the pending updates");
+    parser.addHelpOption();
+    parser.addOptions({
+        { "check", "Print the pending updates, checking if the saved result is out of date." },
+        { "count", "Print only the number of pending updates." },
+        { "list", "Print one \"name old -> new\" line per update (default)." },
+        { "json", "Print the updates as a JSON object." },
+        { "refresh", "Check even if the saved result is current." },
+        { "timing", "Print the time taken as a JSON line on stderr." },
+    });
+    parser.process(app);
+    qint64 startupNs = clock.nsecsElapsed();
+
+    UpdateEngine engine;
+    const UpdateBackend &backend = engine.backend();
+    QTextStream out(stdout);
+    QTextStream err(stderr);
+
+    DiagnosticSample sample;
+    sample.operation = "cli";
+    sample.detail = backend.name();
+
+    auto finish = [&](const QString &error, bool cached) {
+        const UpdateList &updates = engine.updates();
+        if (parser.isSet("json")) {
+            QJsonArray records;
+            for (const UpdateRecord &record : updates.records) {
+                QJsonObject object;
+                object.insert("name", updates.text(record.name));
+                object.insert("old_version", updates.text(record.oldVersion));
+                object.insert("new_version", updates.text(record.newVersion));
+                object.insert("repo", updates.text(record.repo));
+                object.insert("arch", updates.text(record.arch));
+                object.insert("source", QString(sourceName(record.source)));
+                records.append(object);
+            }
+            QJsonObject result;
+            result.insert("backend", backend.name());
+            result.insert("cached", cached);
+            if (!error.isEmpty()) result.insert("error", error);
+            result.insert("count", updates.count());
+            result.insert("updates", records);
+            out << QJsonDocument(result).toJson(QJsonDocument::Compact) << '\n';
+        } else if (!error.isEmpty()) {
+            err << "Update Checker - " << error << '\n';
+        } else if (parser.isSet("count")) {
+            out << updates.count() << '\n';
+        } else {
+            for (const UpdateRecord &record : updates.records) {
+                out << updates.text(record.name) << ' ' << updates.text(record.oldVersion) << " -> "
+                    << updates.text(record.newVersion) << '\n';
+            }
+        }
+        out.flush();
+
+        if (parser.isSet("timing")) {
+            sample.result = error.isEmpty() ? QString("ok") : "error: " + error;
+            sample.addPhase("startup", startupNs);
+            sample.addPhase("total", clock.nsecsElapsed());
+            sample.addCounter("cached", cached);
+            sample.addCounter("updates", updates.count());
+            err << QJsonDocument(sample.toJson()).toJson(QJsonDocument::Compact) << '\n';
+        }
+        return error.isEmpty() ? 0 : 1;
+    };
+
+    if (!backend.isSupported()) return finish("Unsupported distribution", false);
+
+    QString checkError;
+    QObject::connect(&engine, &UpdateProvider::checkFinished, [&checkError](const QString &error) { checkError = error; });
+    // A shared result or a tool that fails to start settles the round
+    // inside checkOnce(), before exit() could end an event loop
+    bool settled = false;
+    QObject::connect(&engine, &UpdateEngine::settled, &app, [&app, &settled]() {
+        settled = true;
+        app.exit();
+    });
+
+    QElapsedTimer resultTimer;
+    resultTimer.start();
+    if (engine.checkOnce(EngineConfig::load(), parser.isSet("refresh"))) {
+        sample.addPhase("result", resultTimer.nsecsElapsed());
+        return finish(QString(), true);
+    }
+    if (!settled) app.exec();
+    sample.addPhase("result", resultTimer.nsecsElapsed());
+    return finish(checkError, false);
+}
+
 int main(int argc, char *argv[]) {
+    QElapsedTimer clock;
+    clock.start();
+
+    for (int i = 1; i < argc; ++i) {
+        if (qstrcmp(argv[i], "--daemon") == 0) return runDaemon(argc, argv);
+    }
+    for (int i = 1; i < argc; ++i) {
+        for (const char *option : { "--check", "--count", "--list", "--json" }) {
+            if (qstrcmp(argv[i], option) == 0) return runCli(argc, argv, clock);
+        }
+    }
+
     QApplication app(argc, argv);
     app.setApplicationName("Update Checker");
     app.setOrganizationName("claudemods");
+    UpdateService::registerTypes();
 
     if (!QSystemTrayIcon::isSystemTrayAvailable()) {
         QMessageBox::critical(nullptr, "Error", "System tray not available");
@@ -529,6 +1126,7 @@ int main(int argc, char *argv[]) {
 
     UpdateChecker checker;
     checker.show();
+    QTimer::singleShot(0, &checker, [&checker, &clock]() { checker.recordStartup(clock); });
 
     return app.exec();
 }
@@ -4,10 +4,38 @@ TARGET = kdeupdater.bin
 # Source files
 SOURCES += main.cpp
 
+HEADERS += aptdb.h \
+           backend.h \
+           checkscheduler.h \
+           dbwatcher.h \
+           diagnostics.h \
+           installprogress.h \
+           lockwatcher.h \
+           pacmandb.h \
+           pacmansync.h \
+           prefetch.h \
+           sharedcache.h \
+           snapshot.h \
+           sources.h \
+           trayicon.h \
+           updatecheck.h \
+           updateengine.h \
+           updatemodel.h \
+           updaterecord.h \
+           updateservice.h \
+           vercmp.h
 
-QT += core gui widgets
+
+QT += core gui widgets concurrent dbus
+# Update checks tune their child process with setChildProcessModifier(),
+# which Qt 5 does not have
+lessThan(QT_MAJOR_VERSION, 6): error("Qt 6 or later is required")
 # C++ standard
 CONFIG += c++23
 
+# Native pacman checks decompress the sync databases themselves
+CONFIG += link_pkgconfig
+PKGCONFIG += zlib libzstd
+
 
 RESOURCES += resources.qrc
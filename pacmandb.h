@@ -0,0 +1,217 @@
+#ifndef PACMANDB_H
+#define PACMANDB_H
+
+#include <QByteArray>
+#include <QDataStream>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QList>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QString>
+#include <QVector>
+#include <QtConcurrent>
+
+#include <algorithm>
+#include <string_view>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace PacmanDesc {
+
+// Returns the first line after `%KEY%` in a pacman desc file
+inline std::string_view field(std::string_view desc, std::string_view key) {
+    std::size_t pos = 0;
+    while ((pos = desc.find(key, pos)) != std::string_view::npos) {
+        bool atLineStart = pos == 0 || desc[pos - 1] == '\n';
+        std::size_t valueStart = pos + key.size();
+        if (atLineStart && valueStart < desc.size() && desc[valueStart] == '\n') {
+            std::string_view value = desc.substr(valueStart + 1);
+            return value.substr(0, value.find('\n'));
+        }
+        pos = valueStart;
+    }
+    return {};
+}
+
+// Every line of the `%KEY%` section, which ends at an empty line
+inline QList<QByteArray> list(std::string_view desc, std::string_view key) {
+    QList<QByteArray> values;
+    std::string_view rest = field(desc, key);
+    if (rest.empty()) return values;
+
+    rest = std::string_view(rest.data(), desc.data() + desc.size() - rest.data());
+    while (!rest.empty()) {
+        std::string_view line = rest.substr(0, rest.find('\n'));
+        if (line.empty()) break;
+        values.append(QByteArray(line.data(), qsizetype(line.size())));
+        rest.remove_prefix(std::min(rest.size(), line.size() + 1));
+    }
+    return values;
+}
+
+} // namespace PacmanDesc
+
+// Installed packages read straight from /var/lib/pacman/local. Every
+// package directory is remembered with the mtime of its desc file, so a
+// refresh only re-reads directories that pacman touched since the last
+// one. The index is persisted between runs.
+class PacmanLocalDb {
+public:
+    struct Package {
+        QByteArray name;
+        QByteArray version;
+        qint64 mtime = 0;
+    };
+
+    PacmanLocalDb(const QString &root = "/var/lib/pacman/local", const QString &cachePath = defaultCachePath())
+        : root(root), cachePath(cachePath) {}
+
+    static QString defaultCachePath() {
+        return QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/pacman-local.cache";
+    }
+
+    // Name to installed version
+    const QHash<QByteArray, QByteArray> &versions() const { return installed; }
+    int count() const { return installed.size(); }
+
+    bool load() {
+        QFile file(cachePath);
+        if (!file.open(QIODevice::ReadOnly)) return false;
+
+        QDataStream in(&file);
+        quint32 magic = 0, version = 0;
+        in >> magic >> version;
+        if (magic != CacheMagic || version != CacheVersion) return false;
+
+        QByteArray cachedRoot;
+        qint32 count = 0;
+        in >> cachedRoot >> count;
+        if (cachedRoot != QFile::encodeName(root) || count < 0) return false;
+
+        QHash<QByteArray, Package> loaded;
+        loaded.reserve(count);
+        for (qint32 i = 0; i < count && in.status() == QDataStream::Ok; ++i) {
+            QByteArray dir;
+            Package package;
+            in >> dir >> package.name >> package.version >> package.mtime;
+            loaded.insert(dir, package);
+        }
+        if (in.status() != QDataStream::Ok) return false;
+
+        packages = std::move(loaded);
+        rebuildVersions();
+        return true;
+    }
+
+    bool save() const {
+        QDir().mkpath(QFileInfo(cachePath).absolutePath());
+        QSaveFile file(cachePath);
+        if (!file.open(QIODevice::WriteOnly)) return false;
+
+        QDataStream out(&file);
+        out << CacheMagic << CacheVersion << QFile::encodeName(root) << qint32(packages.size());
+        for (auto it = packages.cbegin(); it != packages.cend(); ++it) {
+            out << it.key() << it->name << it->version << it->mtime;
+        }
+        return file.commit();
+    }
+
+    // Brings the index in line with the database on disk and returns the
+    // number of package directories that had to be parsed, or -1 if the
+    // database could not be read.
+    int refresh() {
+        QByteArray rootPath = QFile::encodeName(root);
+        DIR *dir = ::opendir(rootPath.constData());
+        if (!dir) return -1;
+
+        struct Work {
+            QByteArray dir;
+            qint64 mtime;
+            Package package;
+            bool ok = false;
+        };
+
+        QHash<QByteArray, Package> current;
+        current.reserve(packages.size());
+        QVector<Work> work;
+
+        int dirFd = ::dirfd(dir);
+        while (struct dirent *entry = ::readdir(dir)) {
+            if (entry->d_name[0] == '.') continue;
+
+            QByteArray name(entry->d_name);
+            struct stat st;
+            if (::fstatat(dirFd, (name + "/desc").constData(), &st, 0) != 0) continue;
+            qint64 mtime = qint64(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+
+            auto cached = packages.constFind(name);
+            if (cached != packages.cend() && cached->mtime == mtime) {
+                current.insert(name, *cached);
+            } else {
+                work.append(Work{ name, mtime, Package(), false });
+            }
+        }
+        ::closedir(dir);
+
+        QString base = root;
+        QtConcurrent::blockingMap(work, [&base](Work &item) {
+            QFile desc(base + '/' + QFile::decodeName(item.dir) + "/desc");
+            if (!desc.open(QIODevice::ReadOnly)) return;
+            QByteArray content = desc.readAll();
+            std::string_view view(content.constData(), content.size());
+
+            std::string_view name = PacmanDesc::field(view, "%NAME%");
+            std::string_view version = PacmanDesc::field(view, "%VERSION%");
+            if (name.empty() || version.empty()) return;
+
+            item.package.name = QByteArray(name.data(), qsizetype(name.size()));
+            item.package.version = QByteArray(version.data(), qsizetype(version.size()));
+            item.package.mtime = item.mtime;
+            item.ok = true;
+        });
+
+        int parsed = 0;
+        for (const Work &item : work) {
+            if (!item.ok) continue;
+            current.insert(item.dir, item.package);
+            ++parsed;
+        }
+
+        // Nothing parsed leaves a subset of the index, smaller only if
+        // packages were removed
+        changed = parsed > 0 || current.size() != packages.size();
+        packages = std::move(current);
+        if (changed) rebuildVersions();
+        return parsed;
+    }
+
+    // Whether the last refresh() added, changed or removed packages, i.e.
+    // whether the saved index is out of date
+    bool isChanged() const { return changed; }
+
+private:
+    static constexpr quint32 CacheMagic = 0x4b55504c; // "KUPL"
+    static constexpr quint32 CacheVersion = 1;
+
+    void rebuildVersions() {
+        installed.clear();
+        installed.reserve(packages.size());
+        for (const Package &package : packages) {
+            installed.insert(package.name, package.version);
+        }
+    }
+
+    QString root;
+    QString cachePath;
+    QHash<QByteArray, Package> packages;    // keyed by directory name
+    QHash<QByteArray, QByteArray> installed;
+    bool changed = false;
+};
+
+#endif // PACMANDB_H
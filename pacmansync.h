@@ -0,0 +1,476 @@
+#ifndef PACMANSYNC_H
+#define PACMANSYNC_H
+
+#include <QByteArray>
+#include <QDataStream>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QMutex>
+#include <QSaveFile>
+#include <QSet>
+#include <QStandardPaths>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <QtConcurrent>
+
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <string_view>
+
+#include <fnmatch.h>
+#include <zlib.h>
+#include <zstd.h>
+
+#include "pacmandb.h"
+#include "updaterecord.h"
+#include "vercmp.h"
+
+namespace PacmanSync {
+
+using Sink = std::function<void(const char *data, std::size_t size)>;
+
+// Reads a ustar stream block by block and hands over the content of each
+// regular file; nothing but the current entry is kept in memory.
+class TarReader {
+public:
+    std::function<void(std::string_view content)> onFile;
+
+    void feed(const char *data, std::size_t size) {
+        while (size > 0 && !ended) {
+            if (inHeader) {
+                std::size_t take = std::min(size, sizeof(header) - headerFill);
+                std::memcpy(header + headerFill, data, take);
+                headerFill += take;
+                data += take;
+                size -= take;
+                if (headerFill < sizeof(header)) return;
+                headerFill = 0;
+                startEntry();
+            } else {
+                std::size_t take = std::min<quint64>(size, remaining);
+                quint64 consumed = padded - remaining;
+                if (keep && consumed < fileSize) {
+                    content.append(data, qsizetype(std::min<quint64>(take, fileSize - consumed)));
+                }
+                remaining -= take;
+                data += take;
+                size -= take;
+                if (remaining == 0) endEntry();
+            }
+        }
+    }
+
+private:
+    void startEntry() {
+        // Two zero blocks end the archive; one is enough for us
+        if (std::all_of(header, header + sizeof(header), [](char c) { return c == 0; })) {
+            ended = true;
+            return;
+        }
+
+        fileSize = 0;
+        for (int i = 124; i < 136 && header[i] >= '0' && header[i] <= '7'; ++i) {
+            fileSize = fileSize * 8 + (header[i] - '0');
+        }
+        padded = (fileSize + 511) & ~quint64(511);
+        remaining = padded;
+
+        char type = header[156];
+        keep = (type == '0' || type == '\0') && fileSize <= MaxFileSize;
+        content.clear();
+        if (keep) content.reserve(qsizetype(fileSize));
+
+        inHeader = false;
+        if (padded == 0) endEntry();
+    }
+
+    void endEntry() {
+        if (keep && onFile) onFile(std::string_view(content.constData(), content.size()));
+        inHeader = true;
+    }
+
+    static constexpr quint64 MaxFileSize = 1 << 20;
+
+    char header[512];
+    std::size_t headerFill = 0;
+    bool inHeader = true;
+    bool ended = false;
+    bool keep = false;
+    quint64 fileSize = 0;
+    quint64 padded = 0;
+    quint64 remaining = 0;
+    QByteArray content;
+};
+
+// Streams the decompressed content of a gzip, zstd or plain tar file into
+// `sink` in fixed size chunks
+inline bool decompress(const QString &path, const Sink &sink, QString &error) {
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        error = file.errorString();
+        return false;
+    }
+
+    constexpr qint64 ChunkSize = 128 * 1024;
+    QByteArray in(ChunkSize, Qt::Uninitialized);
+    QByteArray out(ChunkSize, Qt::Uninitialized);
+
+    QByteArray magic = file.peek(4);
+    if (magic.startsWith("\x1f\x8b")) {
+        z_stream zs = {};
+        if (inflateInit2(&zs, 15 + 32) != Z_OK) {
+            error = "zlib initialisation failed";
+            return false;
+        }
+
+        int ret = Z_OK;
+        while (ret != Z_STREAM_END) {
+            qint64 n = file.read(in.data(), ChunkSize);
+            if (n <= 0) break;
+            zs.next_in = reinterpret_cast<Bytef *>(in.data());
+            zs.avail_in = uInt(n);
+            do {
+                zs.next_out = reinterpret_cast<Bytef *>(out.data());
+                zs.avail_out = uInt(ChunkSize);
+                ret = inflate(&zs, Z_NO_FLUSH);
+                if (ret != Z_OK && ret != Z_STREAM_END && ret != Z_BUF_ERROR) {
+                    inflateEnd(&zs);
+                    error = QString("corrupt gzip data (%1)").arg(ret);
+                    return false;
+                }
+                sink(out.constData(), std::size_t(ChunkSize - zs.avail_out));
+            } while (zs.avail_out == 0 && ret != Z_STREAM_END);
+        }
+        inflateEnd(&zs);
+        if (ret != Z_STREAM_END) {
+            error = "truncated gzip data";
+            return false;
+        }
+        return true;
+    }
+
+    if (magic == QByteArray("\x28\xb5\x2f\xfd", 4)) {
+        ZSTD_DStream *zs = ZSTD_createDStream();
+        if (!zs) {
+            error = "zstd initialisation failed";
+            return false;
+        }
+        ZSTD_initDStream(zs);
+
+        // 0 once a frame is complete; anything else at the end of the file
+        // means it was cut short
+        std::size_t ret = 0;
+        qint64 n = 0;
+        while ((n = file.read(in.data(), ChunkSize)) > 0) {
+            ZSTD_inBuffer input = { in.constData(), std::size_t(n), 0 };
+            ZSTD_outBuffer output;
+            do {
+                output = { out.data(), std::size_t(ChunkSize), 0 };
+                ret = ZSTD_decompressStream(zs, &output, &input);
+                if (ZSTD_isError(ret)) {
+                    error = QString("corrupt zstd data (%1)").arg(ZSTD_getErrorName(ret));
+                    ZSTD_freeDStream(zs);
+                    return false;
+                }
+                sink(out.constData(), output.pos);
+            } while (input.pos < input.size || output.pos == output.size);
+        }
+        ZSTD_freeDStream(zs);
+        if (n < 0) {
+            error = file.errorString();
+            return false;
+        }
+        if (ret != 0) {
+            error = "truncated zstd data";
+            return false;
+        }
+        return true;
+    }
+
+    // Uncompressed databases are valid too (repo-add with no compression)
+    qint64 n = 0;
+    while ((n = file.read(in.data(), ChunkSize)) > 0) {
+        sink(in.constData(), std::size_t(n));
+    }
+    return true;
+}
+
+} // namespace PacmanSync
+
+// The parts of /etc/pacman.conf a native check needs
+class PacmanConf {
+public:
+    static PacmanConf load(const QString &path = "/etc/pacman.conf") {
+        PacmanConf conf;
+        QFile file(path);
+        if (!file.open(QIODevice::ReadOnly)) return conf;
+
+        QString section;
+        while (!file.atEnd()) {
+            QString line = QString::fromUtf8(file.readLine()).trimmed();
+            int comment = line.indexOf('#');
+            if (comment >= 0) line = line.left(comment).trimmed();
+            if (line.isEmpty()) continue;
+
+            if (line.startsWith('[') && line.endsWith(']')) {
+                section = line.mid(1, line.size() - 2).trimmed();
+                if (section != "options" && !conf.repos.contains(section)) conf.repos.append(section);
+                continue;
+            }
+
+            if (section == "options") {
+                int eq = line.indexOf('=');
+                if (eq <= 0) continue;
+                QString key = line.left(eq).trimmed();
+                QList<QByteArray> *patterns = key == "IgnorePkg" ? &conf.ignoredPackages
+                                            : key == "IgnoreGroup" ? &conf.ignoredGroups : nullptr;
+                if (!patterns) continue;
+                for (const QString &pattern : line.mid(eq + 1).split(' ', Qt::SkipEmptyParts)) {
+                    patterns->append(pattern.toUtf8());
+                }
+            }
+        }
+        return conf;
+    }
+
+    // Whether -Su leaves the package alone, by its name or by one of the
+    // groups of the version it would be upgraded to
+    bool ignores(const QByteArray &name, const QList<QByteArray> &groups) const {
+        if (matches(ignoredPackages, name)) return true;
+        return std::any_of(groups.cbegin(), groups.cend(),
+                           [this](const QByteArray &group) { return matches(ignoredGroups, group); });
+    }
+
+    QStringList repos;                  // in priority order
+    QList<QByteArray> ignoredPackages;  // IgnorePkg
+    QList<QByteArray> ignoredGroups;    // IgnoreGroup
+
+private:
+    // As libalpm: shell globs, the last one that matches decides, and a
+    // leading '!' turns a match into an exception
+    static bool matches(const QList<QByteArray> &patterns, const QByteArray &value) {
+        for (auto it = patterns.crbegin(); it != patterns.crend(); ++it) {
+            QByteArray pattern = *it;
+            bool inverted = pattern.startsWith('!');
+            if (inverted || pattern.startsWith('\\')) pattern.remove(0, 1);
+            if (::fnmatch(pattern.constData(), value.constData(), 0) == 0) return !inverted;
+        }
+        return false;
+    }
+};
+
+// Name and version of every package in the sync databases, decoded from
+// the repository tarballs and cached until a database's mtime changes
+class PacmanSyncDb {
+public:
+    struct Repo {
+        QString name;
+        qint64 mtime = 0;
+        qint64 size = 0;
+        QHash<QByteArray, QByteArray> versions;
+        QHash<QByteArray, QList<QByteArray>> groups;    // of the packages that have any
+    };
+
+    PacmanSyncDb(const QString &root = "/var/lib/pacman/sync", const QString &cachePath = defaultCachePath())
+        : root(root), cachePath(cachePath) {}
+
+    static QString defaultCachePath() {
+        return QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/pacman-sync.cache";
+    }
+
+    const QVector<Repo> &repos() const { return repoList; }
+
+    bool load() {
+        QFile file(cachePath);
+        if (!file.open(QIODevice::ReadOnly)) return false;
+
+        QDataStream in(&file);
+        quint32 magic = 0, version = 0;
+        qint32 count = 0;
+        in >> magic >> version >> count;
+        if (magic != CacheMagic || version != CacheVersion || count < 0) return false;
+
+        QVector<Repo> loaded;
+        for (qint32 i = 0; i < count && in.status() == QDataStream::Ok; ++i) {
+            Repo repo;
+            in >> repo.name >> repo.mtime >> repo.size >> repo.versions >> repo.groups;
+            loaded.append(repo);
+        }
+        if (in.status() != QDataStream::Ok) return false;
+
+        repoList = std::move(loaded);
+        return true;
+    }
+
+    bool save() const {
+        QDir().mkpath(QFileInfo(cachePath).absolutePath());
+        QSaveFile file(cachePath);
+        if (!file.open(QIODevice::WriteOnly)) return false;
+
+        QDataStream out(&file);
+        out << CacheMagic << CacheVersion << qint32(repoList.size());
+        for (const Repo &repo : repoList) {
+            out << repo.name << repo.mtime << repo.size << repo.versions << repo.groups;
+        }
+        return file.commit();
+    }
+
+    // Re-reads the databases of `names` that changed since they were cached,
+    // one repository per thread. Returns the number of databases decoded, or
+    // -1 with `error` set if any of them could not be read.
+    int refresh(const QStringList &names, QString &error) {
+        struct Work {
+            Repo repo;
+            bool stale = false;
+            QString error;
+        };
+
+        QVector<Work> work;
+        for (const QString &name : names) {
+            QFileInfo info(root + '/' + name + ".db");
+            if (!info.exists()) continue;
+
+            Work item;
+            item.repo.name = name;
+            item.repo.mtime = info.lastModified().toMSecsSinceEpoch();
+            item.repo.size = info.size();
+
+            auto cached = std::find_if(repoList.cbegin(), repoList.cend(), [&name](const Repo &r) { return r.name == name; });
+            if (cached != repoList.cend() && cached->mtime == item.repo.mtime && cached->size == item.repo.size) {
+                item.repo.versions = cached->versions;
+                item.repo.groups = cached->groups;
+            } else {
+                item.stale = true;
+            }
+            work.append(item);
+        }
+
+        QString base = root;
+        QtConcurrent::blockingMap(work, [&base](Work &item) {
+            if (!item.stale) return;
+
+            PacmanSync::TarReader tar;
+            tar.onFile = [&item](std::string_view content) {
+                std::string_view name = PacmanDesc::field(content, "%NAME%");
+                std::string_view version = PacmanDesc::field(content, "%VERSION%");
+                if (name.empty() || version.empty()) return;
+                QByteArray key(name.data(), qsizetype(name.size()));
+                item.repo.versions.insert(key, QByteArray(version.data(), qsizetype(version.size())));
+                QList<QByteArray> groups = PacmanDesc::list(content, "%GROUPS%");
+                if (!groups.isEmpty()) item.repo.groups.insert(key, groups);
+            };
+
+            PacmanSync::decompress(base + '/' + item.repo.name + ".db",
+                                   [&tar](const char *data, std::size_t size) { tar.feed(data, size); },
+                                   item.error);
+        });
+
+        int decoded = 0;
+        QVector<Repo> refreshed;
+        for (Work &item : work) {
+            if (!item.error.isEmpty()) {
+                error = item.repo.name + ".db: " + item.error;
+                return -1;
+            }
+            if (item.stale) ++decoded;
+            refreshed.append(std::move(item.repo));
+        }
+        repoList = std::move(refreshed);
+        return decoded;
+    }
+
+private:
+    static constexpr quint32 CacheMagic = 0x4b555053; // "KUPS"
+    static constexpr quint32 CacheVersion = 2;
+
+    QString root;
+    QString cachePath;
+    QVector<Repo> repoList;
+};
+
+// checkupdates without the subprocesses: compares the local database with
+// the sync databases as they are on disk. Unlike checkupdates this does not
+// download fresh databases, so it sees what the last `pacman -Sy` fetched.
+class PacmanNativeCheck {
+public:
+    UpdateList run(QByteArray &error) {
+        QMutexLocker locker(&mutex);
+
+        if (!loaded) {
+            local.load();
+            sync.load();
+            loaded = true;
+        }
+
+        int localParsed = local.refresh();
+        if (localParsed < 0) {
+            error = "Cannot read the pacman local database";
+            return UpdateList();
+        }
+
+        PacmanConf conf = PacmanConf::load();
+        QStringList repos = conf.repos;
+        if (repos.isEmpty()) {
+            for (const QFileInfo &db : QDir("/var/lib/pacman/sync").entryInfoList({ "*.db" }, QDir::Files, QDir::Name)) {
+                repos.append(db.completeBaseName());
+            }
+        }
+
+        QString syncError;
+        int syncDecoded = sync.refresh(repos, syncError);
+        if (syncDecoded < 0) {
+            error = syncError.toUtf8();
+            return UpdateList();
+        }
+
+        if (local.isChanged()) local.save();
+        if (syncDecoded > 0) sync.save();
+
+        struct Pending {
+            QByteArray name;
+            QByteArray oldVersion;
+            QByteArray newVersion;
+            QString repo;
+        };
+        QVector<Pending> pending;
+
+        const QHash<QByteArray, QByteArray> &installed = local.versions();
+        for (auto it = installed.cbegin(); it != installed.cend(); ++it) {
+            // The first repository that carries a package wins, as in pacman
+            for (const PacmanSyncDb::Repo &repo : sync.repos()) {
+                auto candidate = repo.versions.constFind(it.key());
+                if (candidate == repo.versions.cend()) continue;
+                if (conf.ignores(it.key(), repo.groups.value(it.key()))) break;
+
+                std::string_view localVersion(it->constData(), it->size());
+                std::string_view syncVersion(candidate->constData(), candidate->size());
+                if (Vercmp::alpm(syncVersion, localVersion) > 0) {
+                    pending.append(Pending{ it.key(), *it, *candidate, repo.name });
+                }
+                break;
+            }
+        }
+
+        std::sort(pending.begin(), pending.end(), [](const Pending &a, const Pending &b) { return a.name < b.name; });
+
+        UpdateList list;
+        list.records.reserve(pending.size());
+        for (const Pending &p : pending) {
+            list.append(p.name, p.oldVersion, p.newVersion, p.repo.toUtf8());
+        }
+        return list;
+    }
+
+private:
+    QMutex mutex;
+    bool loaded = false;
+    PacmanLocalDb local;
+    PacmanSyncDb sync;
+};
+
+#endif // PACMANSYNC_H
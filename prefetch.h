@@ -0,0 +1,164 @@
+#ifndef PREFETCH_H
+#define PREFETCH_H
+
+#include <QByteArray>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QObject>
+#include <QProcess>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QString>
+#include <QStringList>
+#include <QTimer>
+
+#include <unistd.h>
+
+#include "updatecheck.h"
+
+// Downloading pending packages ahead of the install, as the user and at
+// idle priority, into a staging directory in the user's cache. Installs
+// copy staged packages into the system cache as root first, and the
+// package manager verifies those copies as it would its own downloads.
+namespace Prefetch {
+
+inline QString stagingDir(const QString &backend) {
+    return QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/packages/" + backend;
+}
+
+// Only worth pointing an install at when something was downloaded
+inline bool hasStaged(const QString &backend) {
+    return !QDir(stagingDir(backend)).entryList(QDir::Files).isEmpty();
+}
+
+// Single quotes for sh; staging paths come from $HOME
+inline QString shellQuote(const QString &arg) {
+    return "'" + QString(arg).replace('\'', "'\\''") + "'";
+}
+
+// Shell commands, run as root ahead of the install, that copy the staged
+// files matching `pattern` into the package manager's `cacheDir`. Root's
+// package manager only ever reads root's copies, so nothing in the session
+// can swap a package between its verification and its extraction, and the
+// staging directory itself is never written by root. dd with nofollow
+// refuses symlinks planted in it; a package that fails to copy is simply
+// downloaded again.
+inline QString copyStagedCommand(const QString &backend, const QString &pattern, const QString &cacheDir) {
+    if (!hasStaged(backend)) return QString();
+    return "umask 022; for f in " + shellQuote(stagingDir(backend)) + "/" + pattern + "; do "
+           "[ -f \"$f\" ] && dd iflag=nofollow status=none if=\"$f\" of=" + shellQuote(cacheDir) +
+           "/\"${f##*/}\" 2>/dev/null; done; ";
+}
+
+// The databases checkupdates syncs as the user, which are as new as the
+// last check; the system databases cannot be used without root
+inline QString checkupdatesDbPath() {
+    QString configured = qEnvironmentVariable("CHECKUPDATES_DB");
+    if (!configured.isEmpty()) return configured;
+
+    QString tmp = qEnvironmentVariable("TMPDIR", "/tmp");
+    for (const QString &suffix : { QString::number(::getuid()), qEnvironmentVariable("USER") }) {
+        QString path = tmp + "/checkup-db-" + suffix;
+        if (QFileInfo::exists(path + "/sync")) return path;
+    }
+    return QString();
+}
+
+// pacman has no bandwidth option, so the prefetch uses a copy of the
+// system configuration with a rate limited curl as XferCommand. Repository
+// servers are kept as they are, file:// ones included.
+inline bool writePacmanConf(const QString &base, const QString &target, int rateLimitKb) {
+    QFile in(base);
+    if (!in.open(QIODevice::ReadOnly)) return false;
+
+    QByteArray xfer = "XferCommand = /usr/bin/curl --silent --show-error --location --fail --continue-at - ";
+    if (rateLimitKb > 0) xfer += "--limit-rate " + QByteArray::number(rateLimitKb) + "k ";
+    xfer += "--output %o %u\n";
+
+    QSaveFile out(target);
+    if (!out.open(QIODevice::WriteOnly)) return false;
+    while (!in.atEnd()) {
+        QByteArray line = in.readLine();
+        QByteArray key = line.trimmed();
+        if (key.startsWith("XferCommand")) continue;
+        out.write(line);
+        if (key == "[options]") out.write(xfer);
+    }
+    return out.commit();
+}
+
+} // namespace Prefetch
+
+struct PrefetchOptions {
+    QString stagingDir;
+    int rateLimitKb = 0;                    // 0 for no limit
+    QString pacmanConf = "/etc/pacman.conf";
+    QString pacmanDbPath = Prefetch::checkupdatesDbPath();
+};
+
+// Runs one backend prefetch command at idle priority and reports how it went
+class Prefetcher : public QObject {
+    Q_OBJECT
+public:
+    Prefetcher(QObject *parent = nullptr) : QObject(parent) {}
+
+    bool isRunning() const { return process != nullptr; }
+
+    void start(const QString &command, const QStringList &args, int timeoutSec = 3600) {
+        cancel();
+        output.clear();
+        clock.start();
+
+        process = new QProcess(this);
+        process->setProcessChannelMode(QProcess::MergedChannels);
+        UpdateCheck::setIdlePriority(process);
+        connect(process, &QProcess::readyReadStandardOutput, this, [this]() {
+            // Only the end is kept for error messages
+            output += process->readAllStandardOutput();
+            if (output.size() > 8192) output.remove(0, output.size() - 8192);
+        });
+        connect(process, QOverload<int, QProcess::ExitStatus>::of(&QProcess::finished), this,
+                [this](int exitCode, QProcess::ExitStatus status) { done(status == QProcess::NormalExit ? exitCode : -1); });
+        connect(process, &QProcess::errorOccurred, this, [this](QProcess::ProcessError error) {
+            if (error != QProcess::FailedToStart) return;
+            output = process->errorString().toUtf8();
+            done(-1);
+        });
+
+        QTimer::singleShot(timeoutSec * 1000, process, [p = process]() { p->kill(); });
+        process->start(command, args);
+    }
+
+    void cancel() {
+        if (!process) return;
+        QProcess *stale = process;
+        process = nullptr;
+        stale->disconnect(this);
+
+        if (stale->state() == QProcess::NotRunning) {
+            stale->deleteLater();
+        } else {
+            connect(stale, QOverload<int, QProcess::ExitStatus>::of(&QProcess::finished), stale, &QObject::deleteLater);
+            stale->kill();
+        }
+    }
+
+signals:
+    void finished(int exitCode, const QByteArray &output, qint64 elapsedMs);
+
+private:
+    void done(int exitCode) {
+        QProcess *finishedProcess = process;
+        process = nullptr;
+        finishedProcess->disconnect(this);
+        finishedProcess->deleteLater();
+        emit finished(exitCode, output.trimmed(), clock.elapsed());
+    }
+
+    QProcess *process = nullptr;
+    QByteArray output;
+    QElapsedTimer clock;
+};
+
+#endif // PREFETCH_H
@@ -0,0 +1,147 @@
+#ifndef SHAREDCACHE_H
+#define SHAREDCACHE_H
+
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+#include <cerrno>
+
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "snapshot.h"
+#include "updaterecord.h"
+
+// The system check's result shared by every session on the machine, so
+// that with several users logged in one of them runs the package manager
+// and the others take its answer. A session wanting a check first looks
+// for a published result whose database fingerprints match the current
+// ones; failing that it claims the check through an flock() on
+// `check.lock`, runs it and publishes. Sessions finding the claim taken
+// wait for the result instead of spawning their own check.
+//
+// Each user publishes to a file of their own, `system-<uid>.snapshot`, as
+// the cache directory is sticky and nobody may replace another user's
+// file; readers take the newest one that matches. Only the system updates
+// are shared: Flatpak, AUR and the like depend on the user.
+//
+// The directory has to be provided by the system, e.g. through tmpfiles.d
+// with "d /run/kdeupdater 1777 root root -". Without one the cache is off
+// and every session checks on its own as before. KDEUPDATER_SHARED_CACHE
+// names another directory, or turns the cache off when set but empty, so
+// that test runs stay out of the real sessions' way. Whoever can write there
+// can make other sessions show made-up updates, but installs always go
+// through the package manager itself.
+class SharedCheckCache {
+public:
+    SharedCheckCache(const QString &dir = defaultDir()) : dir(dir) {}
+
+    ~SharedCheckCache() {
+        if (lockFd >= 0) ::close(lockFd);
+    }
+
+    SharedCheckCache(const SharedCheckCache &) = delete;
+    SharedCheckCache &operator=(const SharedCheckCache &) = delete;
+
+    static QString defaultDir() {
+        if (qEnvironmentVariableIsSet("KDEUPDATER_SHARED_CACHE")) return qEnvironmentVariable("KDEUPDATER_SHARED_CACHE");
+        for (const QString &candidate : { QString("/var/cache/kdeupdater"), QString("/run/kdeupdater") }) {
+            QFileInfo info(candidate);
+            if (info.isDir() && info.isWritable()) return candidate;
+        }
+        return QString();
+    }
+
+    bool isAvailable() const { return !dir.isEmpty(); }
+    const QString &path() const { return dir; }
+
+    // The newest result published for `fingerprints` that is younger than
+    // `maxAgeMs` and, if `notBefore` is valid, not older than it
+    bool load(const QVector<DbFingerprint> &fingerprints, qint64 maxAgeMs, const QDateTime &notBefore,
+              UpdateSnapshot &result) const {
+        if (!isAvailable()) return false;
+
+        QDateTime now = QDateTime::currentDateTime();
+        bool found = false;
+        const QStringList files = QDir(dir).entryList({ "system-*.snapshot" }, QDir::Files);
+        for (const QString &file : files) {
+            UpdateSnapshot candidate(dir + '/' + file);
+            if (!candidate.load(true) || candidate.fingerprints != fingerprints) continue;
+
+            qint64 age = candidate.timestamp.msecsTo(now);
+            if (age < 0 || age >= maxAgeMs) continue;
+            if (notBefore.isValid() && candidate.timestamp < notBefore) continue;
+            if (found && candidate.timestamp <= result.timestamp) continue;
+
+            result = std::move(candidate);
+            found = true;
+        }
+        return found;
+    }
+
+    enum class Claim {
+        Granted,        // this session checks and publishes
+        Taken,          // another session is checking
+        Unavailable     // the lock cannot be used; check without it
+    };
+
+    // The lock goes away with the process, so a session that crashes
+    // mid-check does not block the others. A lock file left unreadable by
+    // another user must not make every session wait for nobody.
+    Claim claim() {
+        if (!isAvailable() || !openLock()) return Claim::Unavailable;
+        if (::flock(lockFd, LOCK_EX | LOCK_NB) == 0) return Claim::Granted;
+        return errno == EWOULDBLOCK ? Claim::Taken : Claim::Unavailable;
+    }
+
+    void release() {
+        if (lockFd >= 0) ::flock(lockFd, LOCK_UN);
+    }
+
+    // Shares `updates` as the result for the databases in `fingerprints`
+    // and gives up the claim
+    void publish(const QVector<DbFingerprint> &fingerprints, const UpdateList &updates) {
+        if (!isAvailable()) return;
+
+        QString file = dir + "/system-" + QString::number(::getuid()) + ".snapshot";
+        UpdateSnapshot snapshot(file);
+        snapshot.timestamp = QDateTime::currentDateTime();
+        snapshot.fingerprints = fingerprints;
+        snapshot.updates = updates;
+        if (snapshot.save()) {
+            // Whatever the umask, the other sessions have to read it
+            QFile::setPermissions(file, QFile::ReadOwner | QFile::WriteOwner | QFile::ReadGroup | QFile::ReadOther);
+        }
+        release();
+    }
+
+private:
+    // Kept open for the life of the cache; whoever comes first creates it
+    // readable and writable for everybody, whatever their umask
+    bool openLock() {
+        if (lockFd >= 0) return true;
+
+        QByteArray name = QFile::encodeName(dir + "/check.lock");
+        lockFd = ::open(name.constData(), O_RDWR | O_CREAT | O_CLOEXEC | O_NOFOLLOW, 0666);
+        if (lockFd >= 0) {
+            struct stat st;
+            if (::fstat(lockFd, &st) == 0 && st.st_uid == ::getuid()) ::fchmod(lockFd, 0666);
+        } else {
+            // flock() does not need write access
+            lockFd = ::open(name.constData(), O_RDONLY | O_CLOEXEC | O_NOFOLLOW);
+        }
+        return lockFd >= 0;
+    }
+
+    QString dir;
+    int lockFd = -1;
+};
+
+#endif // SHAREDCACHE_H
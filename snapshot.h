@@ -0,0 +1,171 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <QByteArray>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+#include <cstring>
+#include <type_traits>
+
+#include <sys/stat.h>
+
+#include "updaterecord.h"
+
+// Identifies the state of one package database path. Databases are
+// replaced by rename or have entries added and removed, so the inode, size
+// and modification time of the watched paths change whenever the result of
+// a check could.
+struct DbFingerprint {
+    quint64 pathHash = 0;
+    qint64 mtimeNs = 0;
+    qint64 size = 0;
+    quint64 inode = 0;
+
+    bool operator==(const DbFingerprint &other) const = default;
+
+    static DbFingerprint of(const QString &path) {
+        DbFingerprint fingerprint;
+        QByteArray name = QFile::encodeName(path);
+
+        // FNV-1a, stable across runs unlike qHash()
+        fingerprint.pathHash = 14695981039346656037ull;
+        for (char c : name) {
+            fingerprint.pathHash = (fingerprint.pathHash ^ quint8(c)) * 1099511628211ull;
+        }
+
+        struct stat st;
+        if (::stat(name.constData(), &st) == 0) {
+            fingerprint.mtimeNs = qint64(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+            fingerprint.size = st.st_size;
+            fingerprint.inode = st.st_ino;
+        }
+        return fingerprint;
+    }
+
+    static QVector<DbFingerprint> of(const QStringList &paths) {
+        QVector<DbFingerprint> fingerprints;
+        fingerprints.reserve(paths.size());
+        for (const QString &path : paths) fingerprints.append(of(path));
+        return fingerprints;
+    }
+};
+
+// The result of the last successful check, kept on disk so the tray can
+// show it right away on the next start. The file is a fixed header followed
+// by the fingerprints, the records and the record buffer exactly as they
+// are laid out in memory, so loading is a mapping and two copies.
+class UpdateSnapshot {
+public:
+    UpdateSnapshot(const QString &path = defaultPath()) : path(path) {}
+
+    static QString defaultPath() {
+        return QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/last-check.snapshot";
+    }
+
+    QDateTime timestamp;
+    QVector<DbFingerprint> fingerprints;
+    UpdateList updates;
+
+    // `copy` reads the file instead of mapping it, for files other users
+    // own: one cut short under a mapping would fault the reader
+    bool load(bool copy = false) {
+        QFile file(path);
+        if (!file.open(QIODevice::ReadOnly)) return false;
+
+        QByteArray bytes;
+        const uchar *data = nullptr;
+        qint64 size = 0;
+        if (copy) {
+            bytes = file.readAll();
+            data = reinterpret_cast<const uchar *>(bytes.constData());
+            size = bytes.size();
+        } else {
+            size = file.size();
+            if (size >= qint64(sizeof(Header))) data = file.map(0, size);
+        }
+        if (!data || size < qint64(sizeof(Header))) return false;
+
+        Header header;
+        std::memcpy(&header, data, sizeof(header));
+        if (std::memcmp(header.magic, Magic, sizeof(header.magic)) != 0 || header.version != Version) return false;
+
+        qint64 expected = qint64(sizeof(Header)) + qint64(header.fingerprintCount) * qint64(sizeof(DbFingerprint)) +
+                          qint64(header.recordCount) * qint64(sizeof(UpdateRecord)) + qint64(header.bufferSize);
+        if (expected != size) return false;
+
+        const uchar *p = data + sizeof(Header);
+        QVector<DbFingerprint> loadedFingerprints(header.fingerprintCount);
+        std::memcpy(loadedFingerprints.data(), p, header.fingerprintCount * sizeof(DbFingerprint));
+        p += header.fingerprintCount * sizeof(DbFingerprint);
+
+        UpdateList loaded;
+        loaded.records.resize(header.recordCount);
+        std::memcpy(loaded.records.data(), p, header.recordCount * sizeof(UpdateRecord));
+        p += header.recordCount * sizeof(UpdateRecord);
+        loaded.buffer = QByteArray(reinterpret_cast<const char *>(p), header.bufferSize);
+
+        // Never hand out fields pointing outside the buffer
+        for (const UpdateRecord &record : loaded.records) {
+            if (quint32(record.source) > quint32(UpdateSource::Firmware)) return false;
+            for (const UpdateField &field : { record.name, record.oldVersion, record.newVersion, record.repo, record.arch }) {
+                if (quint64(field.offset) + field.length > header.bufferSize) return false;
+            }
+        }
+
+        timestamp = QDateTime::fromMSecsSinceEpoch(header.timestampMs);
+        fingerprints = std::move(loadedFingerprints);
+        updates = std::move(loaded);
+        return true;
+    }
+
+    bool save() const {
+        QDir().mkpath(QFileInfo(path).absolutePath());
+        QSaveFile file(path);
+        if (!file.open(QIODevice::WriteOnly)) return false;
+
+        Header header;
+        std::memcpy(header.magic, Magic, sizeof(header.magic));
+        header.version = Version;
+        header.timestampMs = timestamp.toMSecsSinceEpoch();
+        header.fingerprintCount = quint32(fingerprints.size());
+        header.recordCount = quint32(updates.records.size());
+        header.bufferSize = quint32(updates.buffer.size());
+
+        file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        file.write(reinterpret_cast<const char *>(fingerprints.constData()), fingerprints.size() * sizeof(DbFingerprint));
+        file.write(reinterpret_cast<const char *>(updates.records.constData()), updates.records.size() * sizeof(UpdateRecord));
+        file.write(updates.buffer);
+        return file.commit();
+    }
+
+private:
+    static constexpr char Magic[4] = { 'K', 'U', 'P', 'C' };
+    static constexpr quint32 Version = 2;    // 2: records carry their source
+
+    struct Header {
+        char magic[4];
+        quint32 version;
+        qint64 timestampMs;
+        quint32 fingerprintCount;
+        quint32 recordCount;
+        quint32 bufferSize;
+        quint32 reserved = 0;
+    };
+
+    // The layout on disk is the layout in memory
+    static_assert(std::is_trivially_copyable_v<DbFingerprint> && sizeof(DbFingerprint) == 32);
+    static_assert(std::is_trivially_copyable_v<UpdateRecord> && sizeof(UpdateRecord) == 44);
+    static_assert(sizeof(Header) == 32);
+
+    QString path;
+};
+
+#endif // SNAPSHOT_H
@@ -0,0 +1,106 @@
+#ifndef SOURCES_H
+#define SOURCES_H
+
+#include <QList>
+#include <QMap>
+#include <QObject>
+#include <QStandardPaths>
+#include <QString>
+#include <QStringList>
+
+#include "updatecheck.h"
+#include "updaterecord.h"
+
+// An optional source of updates next to the system package manager
+struct ExtraSource {
+    UpdateSource id;
+    QString title;
+    QString program;
+    QStringList args;
+    UpdateFormat format;
+    int timeoutSec;
+    QList<int> okExitCodes;     // besides 0, e.g. "nothing to update"
+
+    bool isAvailable() const { return !QStandardPaths::findExecutable(program).isEmpty(); }
+
+    static QList<ExtraSource> all() {
+        // Whichever AUR helper is installed; both exit with 1 when nothing
+        // is out of date
+        QString aurHelper = QStandardPaths::findExecutable("paru").isEmpty() &&
+                                    !QStandardPaths::findExecutable("yay").isEmpty() ? "yay" : "paru";
+
+        return {
+            { UpdateSource::Flatpak, "Flatpak applications", "flatpak",
+              { "remote-ls", "--updates", "--columns=application,version,origin" }, UpdateFormat::Flatpak, 120, {} },
+            { UpdateSource::Snap, "Snap packages", "snap", { "refresh", "--list" }, UpdateFormat::Snap, 60, {} },
+            { UpdateSource::Aur, "AUR packages", aurHelper, { "-Qua" }, UpdateFormat::Checkupdates, 180, { 1 } },
+            { UpdateSource::Firmware, "Firmware", "fwupdmgr",
+              { "get-updates", "--json", "--no-unreported-check", "--no-metadata-check" }, UpdateFormat::Fwupd, 120, { 2 } },
+        };
+    }
+};
+
+// Runs the enabled extra sources in parallel, each as its own bounded
+// UpdateCheck, and reports every source as soon as it is done so that a
+// slow one never holds back the others. A source still running from an
+// earlier round is left to finish rather than started again.
+class SourceChecks : public QObject {
+    Q_OBJECT
+public:
+    SourceChecks(QObject *parent = nullptr) : QObject(parent) {}
+
+    bool isRunning() const {
+        for (UpdateCheck *check : checks) {
+            if (check->isRunning()) return true;
+        }
+        return false;
+    }
+
+    void start(const QList<ExtraSource> &sources, const UpdateCheck::Limits &limits) {
+        for (const ExtraSource &source : sources) {
+            if (!source.isAvailable()) continue;
+
+            UpdateCheck *&check = checks[source.id];
+            if (!check) {
+                check = new UpdateCheck(this);
+                connect(check, &UpdateCheck::finished, this,
+                        [this, id = source.id](const UpdateList &updates, const QByteArray &error, int exitCode) {
+                            onFinished(id, updates, error, exitCode);
+                        });
+            }
+            if (check->isRunning()) continue;
+
+            UpdateCheck::Limits sourceLimits = limits;
+            sourceLimits.timeoutSec = source.timeoutSec;
+            check->setLimits(sourceLimits);
+            okExitCodes[source.id] = source.okExitCodes;
+            check->start(source.program, source.args, source.format);
+        }
+    }
+
+    void cancel() {
+        for (UpdateCheck *check : checks) check->cancel();
+    }
+
+    const UpdateCheck::Timing &timing(UpdateSource source) const { return checks.value(source)->timing(); }
+
+signals:
+    // `error` is empty if the source answered
+    void finished(UpdateSource source, const UpdateList &updates, const QByteArray &error);
+
+private:
+    void onFinished(UpdateSource source, const UpdateList &updates, const QByteArray &error, int exitCode) {
+        // Many of these tools report "nothing to do" on stderr and through
+        // their exit status, so only those decide about failure
+        bool ok = !checks.value(source)->timing().timedOut &&
+                  (exitCode == 0 || okExitCodes.value(source).contains(exitCode));
+        QByteArray reason = error.trimmed();
+        if (!ok && reason.isEmpty()) reason = "exited with status " + QByteArray::number(exitCode);
+        emit finished(source, ok ? updates : UpdateList(), ok ? QByteArray() : reason);
+    }
+
+    QMap<UpdateSource, UpdateCheck *> checks;
+    QMap<UpdateSource, QList<int>> okExitCodes;
+};
+
+#endif // SOURCES_H
@@ -0,0 +1,142 @@
+#ifndef TRAYICON_H
+#define TRAYICON_H
+
+#include <QCache>
+#include <QColor>
+#include <QFont>
+#include <QGuiApplication>
+#include <QHash>
+#include <QIcon>
+#include <QPainter>
+#include <QPixmap>
+#include <QString>
+
+#include <algorithm>
+#include <cmath>
+
+// Draws the tray icon: one of the three SVGs, the number of pending updates
+// as a badge and, while installing, a progress ring around it. An icon with
+// nothing drawn on it is the SVG itself, which Qt renders at whatever size
+// the tray asks for, so startup rasterizes nothing up front. The SVGs are
+// rasterized once per size and device pixel ratio for the rest, and
+// finished icons are cached by (state, count bucket, progress bucket,
+// device pixel ratio), so following an install step by step only paints
+// what is new.
+class TrayIconRenderer {
+public:
+    enum State : quint8 { NoUpdates, UpdatesAvailable, Updated, Installing };
+
+    // Rendering work done so far, for the benchmark
+    struct Stats {
+        int svgRenders = 0;     // SVG rasterizations
+        int composed = 0;       // icons painted
+        int hits = 0;           // icons served from the cache
+    };
+
+    // Counts above this share one "99+" badge
+    static constexpr int MaxBadge = 99;
+
+    // `percent` below 0 draws no ring
+    QIcon icon(State state, int count = 0, int percent = -1) {
+        return icon(state, count, percent, qGuiApp->devicePixelRatio());
+    }
+
+    QIcon icon(State state, int count, int percent, qreal devicePixelRatio) {
+        int countBucket = state == NoUpdates ? 0 : std::clamp(count, 0, MaxBadge + 1);
+        // A ring 2% at a time is smooth at tray sizes and keeps the cache small
+        int percentBucket = state == Installing && percent >= 0 ? std::min(percent, 100) / 2 * 2 : 0xff;
+        quint64 key = quint64(state) | quint64(countBucket) << 8 | quint64(percentBucket) << 16 |
+                      quint64(std::lround(devicePixelRatio * 100)) << 24;
+
+        if (const QIcon *cached = icons.object(key)) {
+            ++counters.hits;
+            return *cached;
+        }
+
+        QIcon result;
+        if (countBucket == 0 && percentBucket == 0xff) {
+            result = QIcon(svgPath(state));
+            icons.insert(key, new QIcon(result));
+            return result;
+        }
+        for (int size : { 16, 22, 32, 48, 64 }) {
+            result.addPixmap(compose(state, countBucket, percentBucket, size, devicePixelRatio));
+        }
+        icons.insert(key, new QIcon(result));
+        ++counters.composed;
+        return result;
+    }
+
+    const Stats &stats() const { return counters; }
+
+    // Drops every raster and cached icon; icons handed out stay valid
+    void release() {
+        rasters.clear();
+        rasters.squeeze();
+        icons.clear();
+    }
+
+private:
+    static QString svgPath(State state) {
+        switch (state) {
+        case NoUpdates: return ":/images/no-updates.svg";
+        case Updated: return ":/images/updated.svg";
+        case UpdatesAvailable:
+        case Installing: break;
+        }
+        return ":/images/updates.svg";
+    }
+
+    const QPixmap &svg(State state, int size, qreal devicePixelRatio) {
+        QString path = svgPath(state);
+        QString key = path + '@' + QString::number(size) + 'x' + QString::number(devicePixelRatio);
+        auto it = rasters.find(key);
+        if (it == rasters.end()) {
+            it = rasters.insert(key, QIcon(path).pixmap(QSize(size, size), devicePixelRatio));
+            ++counters.svgRenders;
+        }
+        return *it;
+    }
+
+    // Paints in logical pixels; the pixmap carries the device pixel ratio
+    QPixmap compose(State state, int countBucket, int percentBucket, int size, qreal devicePixelRatio) {
+        QPixmap pixmap = svg(state, size, devicePixelRatio);
+        if (countBucket == 0 && percentBucket == 0xff) return pixmap;
+
+        QPainter painter(&pixmap);
+        painter.setRenderHint(QPainter::Antialiasing);
+        QColor accent("#24ffff");
+
+        if (percentBucket != 0xff) {
+            qreal width = size * 6 / 64.0;
+            painter.setPen(QPen(accent, width, Qt::SolidLine, Qt::FlatCap));
+            painter.drawArc(QRectF(width / 2, width / 2, size - width, size - width),
+                            90 * 16, -percentBucket * 360 * 16 / 100);
+        }
+
+        // Too small to read at 16 pixels
+        if (countBucket > 0 && size > 16) {
+            QString text = countBucket > MaxBadge ? QString("99+") : QString::number(countBucket);
+            qreal diameter = size * 0.55;
+            QRectF badge(size - diameter, size - diameter, diameter, diameter);
+
+            painter.setPen(Qt::NoPen);
+            painter.setBrush(accent);
+            painter.drawEllipse(badge);
+
+            QFont font = painter.font();
+            font.setBold(true);
+            font.setPixelSize(std::max(1, int(diameter * (text.size() > 2 ? 0.38 : text.size() > 1 ? 0.5 : 0.65))));
+            painter.setFont(font);
+            painter.setPen(Qt::black);
+            painter.drawText(badge, Qt::AlignCenter, text);
+        }
+        return pixmap;
+    }
+
+    QHash<QString, QPixmap> rasters;
+    QCache<quint64, QIcon> icons{128};
+    Stats counters;
+};
+
+#endif // TRAYICON_H
@@ -0,0 +1,270 @@
+#ifndef UPDATECHECK_H
+#define UPDATECHECK_H
+
+#include <QObject>
+#include <QProcess>
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QFutureWatcher>
+#include <QString>
+#include <QStandardPaths>
+#include <QStringList>
+#include <QTimer>
+#include <QtConcurrent>
+
+#include <functional>
+
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "updaterecord.h"
+
+// Runs a single update check without blocking the event loop, either as a
+// package manager subprocess whose output is parsed as it arrives, or as a
+// native check on the thread pool. The result is delivered through
+// finished(); cancel() drops the run without emitting finished().
+//
+// Subprocesses are bounded by Limits: a hard timeout after which they are
+// terminated and then killed, idle CPU and IO priority, and optionally a
+// transient systemd user scope with CPU and memory caps.
+class UpdateCheck : public QObject {
+    Q_OBJECT
+public:
+    using NativeCheck = std::function<UpdateList(QByteArray &error)>;
+
+    // Nanoseconds since start() for each milestone of the last run, -1 if
+    // it was not reached
+    struct Timing {
+        qint64 spawnNs = -1;
+        qint64 firstByteNs = -1;
+        qint64 totalNs = -1;
+        qint64 parseNs = 0;
+        qint64 bytes = 0;
+
+        // CPU time of every child reaped while the subprocess ran, which
+        // takes in the source checks and the prefetch running next to it,
+        // and the peak RSS of all children reaped so far. Qt reaps the
+        // subprocess itself, so its own usage cannot be read apart.
+        qint64 childrenUserCpuUs = 0;
+        qint64 childrenSystemCpuUs = 0;
+        qint64 childrenMaxRssKb = 0;
+        bool timedOut = false;
+    };
+
+    struct Limits {
+        int timeoutSec = 300;
+        bool lowPriority = true;
+        bool useScope = false;
+        int cpuQuotaPercent = 50;
+        int memoryMaxMb = 1024;
+    };
+
+    UpdateCheck(QObject *parent = nullptr) : QObject(parent) {
+        timeoutTimer = new QTimer(this);
+        timeoutTimer->setSingleShot(true);
+        connect(timeoutTimer, &QTimer::timeout, this, &UpdateCheck::processTimedOut);
+    }
+
+    void setLimits(const Limits &newLimits) { limits = newLimits; }
+
+    // Starts the process at nice 19 in the idle IO class
+    static void setIdlePriority(QProcess *process) {
+        // Runs in the child between fork and exec
+        process->setChildProcessModifier([]() {
+            ::setpriority(PRIO_PROCESS, 0, 19);
+            ::syscall(SYS_ioprio_set, IoprioWhoProcess, 0, IoprioClassIdle << IoprioClassShift);
+        });
+    }
+
+    bool isRunning() const { return process != nullptr || watcher != nullptr; }
+    const Timing &timing() const { return lastTiming; }
+
+    void start(const QString &command, const QStringList &args, UpdateFormat format) {
+        cancel();
+        error.clear();
+        parser.reset(format);
+        lastTiming = Timing();
+        clock.start();
+        ::getrusage(RUSAGE_CHILDREN, &usageBefore);
+
+        process = new QProcess(this);
+        connect(process, &QProcess::started, this, [this]() { lastTiming.spawnNs = clock.nsecsElapsed(); });
+        connect(process, &QProcess::readyReadStandardOutput, this, &UpdateCheck::readOutput);
+        connect(process, &QProcess::readyReadStandardError, this, &UpdateCheck::readError);
+        connect(process, QOverload<int, QProcess::ExitStatus>::of(&QProcess::finished),
+                this, &UpdateCheck::processFinished);
+        connect(process, &QProcess::errorOccurred, this, &UpdateCheck::processError);
+
+        if (limits.lowPriority) setIdlePriority(process);
+
+        QString scope = limits.useScope ? QStandardPaths::findExecutable("systemd-run") : QString();
+        if (scope.isEmpty()) {
+            process->start(command, args);
+        } else {
+            QStringList scopeArgs = { "--user", "--scope", "--quiet", "--collect",
+                                      "-p", QString("CPUQuota=%1%").arg(limits.cpuQuotaPercent),
+                                      "-p", QString("MemoryMax=%1M").arg(limits.memoryMaxMb),
+                                      "--", command };
+            process->start(scope, scopeArgs + args);
+        }
+        if (limits.timeoutSec > 0) timeoutTimer->start(limits.timeoutSec * 1000);
+    }
+
+    void startNative(const NativeCheck &check) {
+        cancel();
+        lastTiming = Timing();
+        clock.start();
+
+        watcher = new QFutureWatcher<NativeResult>(this);
+        connect(watcher, &QFutureWatcher<NativeResult>::finished, this, &UpdateCheck::nativeFinished);
+        watcher->setFuture(QtConcurrent::run([check]() {
+            NativeResult result;
+            result.list = check(result.error);
+            return result;
+        }));
+    }
+
+    void cancel() {
+        timeoutTimer->stop();
+        if (process) {
+            QProcess *stale = process;
+            process = nullptr;
+            stale->disconnect(this);
+
+            if (stale->state() == QProcess::NotRunning) {
+                stale->deleteLater();
+            } else {
+                connect(stale, QOverload<int, QProcess::ExitStatus>::of(&QProcess::finished),
+                        stale, &QObject::deleteLater);
+                stale->kill();
+            }
+        } else if (watcher) {
+            // A native check cannot be interrupted; let it finish unobserved
+            QFutureWatcher<NativeResult> *stale = watcher;
+            watcher = nullptr;
+            stale->disconnect(this);
+            connect(stale, &QFutureWatcher<NativeResult>::finished, stale, &QObject::deleteLater);
+        } else {
+            return;
+        }
+
+        parser.reset(UpdateFormat::Checkupdates);
+        emit canceled();
+    }
+
+signals:
+    void outputReady(const QByteArray &chunk);
+    void finished(const UpdateList &updates, const QByteArray &error, int exitCode);
+    void canceled();
+
+private slots:
+    void readOutput() {
+        QByteArray chunk = process->readAllStandardOutput();
+        if (chunk.isEmpty()) return;
+
+        qint64 received = clock.nsecsElapsed();
+        if (lastTiming.firstByteNs < 0) lastTiming.firstByteNs = received;
+        lastTiming.bytes += chunk.size();
+        parser.feed(chunk);
+        lastTiming.parseNs += clock.nsecsElapsed() - received;
+
+        emit outputReady(chunk);
+    }
+
+    void readError() {
+        error += process->readAllStandardError();
+    }
+
+    void processFinished(int exitCode, QProcess::ExitStatus exitStatus) {
+        // Drain anything that arrived after the last readyRead
+        readOutput();
+        readError();
+
+        // Whatever a hung process printed before it was stopped is not an answer
+        if (lastTiming.timedOut) {
+            error = process->program().toUtf8() + " did not finish within " + QByteArray::number(limits.timeoutSec) + " s";
+            parser.reset(UpdateFormat::Checkupdates);
+        } else if (exitStatus == QProcess::CrashExit && error.isEmpty()) {
+            error = process->program().toUtf8() + " terminated unexpectedly";
+        }
+        finishProcess(exitCode);
+    }
+
+    void processError(QProcess::ProcessError processError) {
+        // Everything except a failed start is followed by finished()
+        if (processError != QProcess::FailedToStart) return;
+        error = "Failed to start " + process->program().toUtf8() + ": " + process->errorString().toUtf8();
+        finishProcess(-1);
+    }
+
+    void processTimedOut() {
+        if (!process) return;
+        lastTiming.timedOut = true;
+
+        // SIGTERM first so it can clean up, SIGKILL if that is ignored
+        process->terminate();
+        QTimer::singleShot(KillGraceMs, process, [p = process]() { p->kill(); });
+    }
+
+    void nativeFinished() {
+        QFutureWatcher<NativeResult> *done = watcher;
+        watcher = nullptr;
+        done->deleteLater();
+
+        NativeResult result = done->result();
+        lastTiming.totalNs = clock.nsecsElapsed();
+        lastTiming.parseNs = lastTiming.totalNs;
+        emit finished(result.list, result.error, result.error.isEmpty() ? 0 : 1);
+    }
+
+private:
+    struct NativeResult {
+        UpdateList list;
+        QByteArray error;
+    };
+
+    void finishProcess(int exitCode) {
+        timeoutTimer->stop();
+        recordUsage();
+
+        QProcess *done = process;
+        process = nullptr;
+        done->disconnect(this);
+        done->deleteLater();
+
+        qint64 parseStart = clock.nsecsElapsed();
+        parser.finish();
+        lastTiming.totalNs = clock.nsecsElapsed();
+        lastTiming.parseNs += lastTiming.totalNs - parseStart;
+
+        emit finished(parser.take(), error, exitCode);
+    }
+
+    // All children reaped since start(), not only the subprocess
+    void recordUsage() {
+        struct rusage after;
+        ::getrusage(RUSAGE_CHILDREN, &after);
+        auto us = [](const timeval &tv) { return qint64(tv.tv_sec) * 1000000 + tv.tv_usec; };
+        lastTiming.childrenUserCpuUs = us(after.ru_utime) - us(usageBefore.ru_utime);
+        lastTiming.childrenSystemCpuUs = us(after.ru_stime) - us(usageBefore.ru_stime);
+        lastTiming.childrenMaxRssKb = after.ru_maxrss;
+    }
+
+    static constexpr int KillGraceMs = 5000;
+    static constexpr int IoprioWhoProcess = 1;
+    static constexpr int IoprioClassIdle = 3;
+    static constexpr int IoprioClassShift = 13;
+
+    QProcess *process = nullptr;
+    QFutureWatcher<NativeResult> *watcher = nullptr;
+    UpdateParser parser;
+    QByteArray error;
+    QElapsedTimer clock;
+    Timing lastTiming;
+    Limits limits;
+    QTimer *timeoutTimer = nullptr;
+    struct rusage usageBefore = {};
+};
+
+#endif // UPDATECHECK_H
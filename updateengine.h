@@ -0,0 +1,606 @@
+#ifndef UPDATEENGINE_H
+#define UPDATEENGINE_H
+
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QFileSystemWatcher>
+#include <QMap>
+#include <QObject>
+#include <QSettings>
+#include <QString>
+#include <QStringList>
+#include <QTimer>
+
+#include <algorithm>
+
+#include "backend.h"
+#include "checkscheduler.h"
+#include "dbwatcher.h"
+#include "diagnostics.h"
+#include "installprogress.h"
+#include "sharedcache.h"
+#include "snapshot.h"
+#include "sources.h"
+#include "updatecheck.h"
+#include "updaterecord.h"
+
+// How and when the engine checks. The tray and the daemon read the same
+// settings, so whichever runs the checks follows the configuration dialog.
+struct EngineConfig {
+    bool autoCheckEnabled = true;
+    int autoCheckInterval = 60;         // minutes
+    bool watchDatabases = true;
+    int fallbackCheckInterval = 360;    // minutes, while watching
+    bool useNativeCheck = false;
+    UpdateCheck::Limits checkLimits;
+    QStringList extraSources;           // sourceName() of each enabled source
+
+    static EngineConfig load() {
+        QSettings settings;
+        EngineConfig config;
+        config.autoCheckEnabled = settings.value("autoCheckEnabled", config.autoCheckEnabled).toBool();
+        config.autoCheckInterval = settings.value("autoCheckInterval", config.autoCheckInterval).toInt();
+        config.watchDatabases = settings.value("watchDatabases", config.watchDatabases).toBool();
+        config.fallbackCheckInterval = settings.value("fallbackCheckInterval", config.fallbackCheckInterval).toInt();
+        config.useNativeCheck = settings.value("useNativeCheck", config.useNativeCheck).toBool();
+        config.checkLimits.timeoutSec = settings.value("checkTimeout", config.checkLimits.timeoutSec).toInt();
+        config.checkLimits.lowPriority = settings.value("checkLowPriority", config.checkLimits.lowPriority).toBool();
+        config.checkLimits.useScope = settings.value("checkInScope", config.checkLimits.useScope).toBool();
+        config.checkLimits.cpuQuotaPercent = settings.value("checkCpuQuota", config.checkLimits.cpuQuotaPercent).toInt();
+        config.checkLimits.memoryMaxMb = settings.value("checkMemoryMax", config.checkLimits.memoryMaxMb).toInt();
+        config.extraSources = settings.value("extraSources").toStringList();
+        return config;
+    }
+
+    void save() const {
+        QSettings settings;
+        settings.setValue("autoCheckEnabled", autoCheckEnabled);
+        settings.setValue("autoCheckInterval", autoCheckInterval);
+        settings.setValue("watchDatabases", watchDatabases);
+        settings.setValue("fallbackCheckInterval", fallbackCheckInterval);
+        settings.setValue("useNativeCheck", useNativeCheck);
+        settings.setValue("checkTimeout", checkLimits.timeoutSec);
+        settings.setValue("checkLowPriority", checkLimits.lowPriority);
+        settings.setValue("checkInScope", checkLimits.useScope);
+        settings.setValue("checkCpuQuota", checkLimits.cpuQuotaPercent);
+        settings.setValue("checkMemoryMax", checkLimits.memoryMaxMb);
+        settings.setValue("extraSources", extraSources);
+    }
+};
+
+// The pending updates as a frontend sees them, whether the checks run in
+// the same process (UpdateEngine) or in the update daemon
+// (UpdateServiceClient).
+class UpdateProvider : public QObject {
+    Q_OBJECT
+public:
+    UpdateProvider(QObject *parent = nullptr) : QObject(parent) {}
+
+    const UpdateBackend &backend() const { return detected; }
+
+    // The system's updates followed by those of the extra sources
+    const UpdateList &updates() const { return availableUpdates; }
+    int count() const { return availableUpdates.count(); }
+
+    // The updates the system package manager installs
+    int systemCount() const {
+        return int(std::count_if(availableUpdates.records.cbegin(), availableUpdates.records.cend(),
+                                 [](const UpdateRecord &record) { return record.source == UpdateSource::System; }));
+    }
+    bool hasExtraUpdates() const { return systemCount() != count(); }
+
+    bool hasResult() const { return haveResult; }
+    DiagnosticsLog &diagnostics() { return log; }
+
+    virtual bool isChecking() const = 0;
+    virtual void requestCheck(CheckScheduler::Trigger trigger) = 0;
+    virtual void cancelCheck() = 0;
+    virtual void setConfig(const EngineConfig &config) = 0;
+
+    // Installs run in the frontend; other clients follow them through this
+    virtual void reportInstallProgress(const InstallProgress &progress) = 0;
+
+signals:
+    void checkStarted();
+    void waitingForLock(int msec);
+    void checkCanceled();
+    // The system check ended; `error` is empty if it succeeded
+    void checkFinished(const QString &error);
+    // The pending updates are not what was last reported. Always emitted
+    // for the first result; `announce` is false for a result that was
+    // already shown before, such as the one saved by the last session.
+    void updatesChanged(const UpdateDelta &delta, bool announce);
+    void installProgress(const InstallProgress &progress);
+
+protected:
+    // Takes `updates` as the pending set and reports it if it changed; the
+    // time spent in the frontend's handlers is added to `sample`
+    void setUpdates(const UpdateList &updates, bool announce, DiagnosticSample *sample = nullptr) {
+        // Swapping in the new generation releases the previous one as a
+        // whole; an unchanged result keeps the block already there
+        UpdateList next = updates.compacted();
+        if (!(next == availableUpdates)) availableUpdates = std::move(next);
+        QElapsedTimer diffTimer;
+        diffTimer.start();
+        UpdateSet current(availableUpdates);
+        UpdateDelta delta = UpdateDelta::between(pendingUpdates, current);
+        qint64 diffNs = diffTimer.nsecsElapsed();
+        bool first = !haveResult;
+        pendingUpdates = current;
+        haveResult = true;
+
+        if (sample) {
+            sample->addPhase("diff", diffNs);
+            sample->addCounter("added", delta.added.size());
+            sample->addCounter("removed", delta.removed.size());
+            sample->addCounter("bumped", delta.bumped.size());
+        }
+        if (!first && delta.isEmpty()) return;
+
+        QElapsedTimer uiTimer;
+        uiTimer.start();
+        emit updatesChanged(delta, announce);
+        if (sample) sample->addPhase("ui", uiTimer.nsecsElapsed());
+    }
+
+    UpdateBackend detected;
+    DiagnosticsLog log;
+
+private:
+    UpdateList availableUpdates;
+    UpdateSet pendingUpdates;
+    bool haveResult = false;
+};
+
+// Checks for updates without any UI: detects the package manager, runs
+// scheduled and requested checks through the CheckScheduler, merges the
+// extra sources and keeps the snapshot of the last result. The system
+// check is shared with the other sessions on the machine through the
+// SharedCheckCache when there is one.
+class UpdateEngine : public UpdateProvider {
+    Q_OBJECT
+public:
+    UpdateEngine(QObject *parent = nullptr) : UpdateProvider(parent) {
+        // Update checks run asynchronously and report back through signals
+        updateCheck = new UpdateCheck(this);
+        connect(updateCheck, &UpdateCheck::finished, this, &UpdateEngine::onCheckFinished);
+
+        // Flatpak, Snap and the like are checked next to it, each on its own
+        sourceChecks = new SourceChecks(this);
+        connect(sourceChecks, &SourceChecks::finished, this, &UpdateEngine::onSourceFinished);
+
+        // Every trigger goes through the scheduler so checks never overlap
+        checkScheduler = new CheckScheduler(updateCheck, this);
+        connect(checkScheduler, &CheckScheduler::runRequested, this, &UpdateEngine::runCheck);
+        connect(checkScheduler, &CheckScheduler::canceled, this, &UpdateEngine::onCheckCanceled);
+        connect(checkScheduler, &CheckScheduler::waitingForLock, this, &UpdateProvider::waitingForLock);
+
+        // The package manager only needs to be detected once
+        QElapsedTimer detectTimer;
+        detectTimer.start();
+        detected = UpdateBackend::detect(OsRelease::load());
+        detectNs = detectTimer.nsecsElapsed();
+
+        UpdateBackend lockOwner = detected;
+        checkScheduler->setLock(detected.lockFile(), [lockOwner]() { return lockOwner.isLocked(); });
+        checkScheduler->setBusy([this]() { return waitingForSession; });
+
+        databaseWatcher = new DatabaseWatcher(this);
+        connect(databaseWatcher, &DatabaseWatcher::changed, this, [this]() { requestCheck(CheckScheduler::Trigger::DatabaseChange); });
+
+        autoCheckTimer = new QTimer(this);
+        connect(autoCheckTimer, &QTimer::timeout, this, [this]() { requestCheck(CheckScheduler::Trigger::Timer); });
+
+        // A session that gives up its claim without publishing is only
+        // noticed by polling
+        sessionPollTimer = new QTimer(this);
+        sessionPollTimer->setInterval(10 * 1000);
+        connect(sessionPollTimer, &QTimer::timeout, this, &UpdateEngine::retryAfterSession);
+    }
+
+    // Shows the result of the last check right away and starts the
+    // schedule; the startup check is skipped while that result is current
+    void start(const EngineConfig &newConfig) {
+        config = newConfig;
+        updateCheck->setLimits(config.checkLimits);
+
+        DiagnosticSample startup;
+        startup.operation = "startup";
+        startup.detail = detected.name();
+        startup.addPhase("detect", detectNs);
+
+        QElapsedTimer snapshotTimer;
+        snapshotTimer.start();
+        bool snapshotCurrent = restoreSnapshot();
+        startup.addPhase("snapshot", snapshotTimer.nsecsElapsed());
+        startup.addCounter("snapshot_current", snapshotCurrent);
+        log.record(startup);
+
+        if (!snapshotCurrent) {
+            QTimer::singleShot(1000, this, [this]() { requestCheck(CheckScheduler::Trigger::Startup); });
+        }
+        applySchedule();
+    }
+
+    // For a caller that exits after one result, like the command line.
+    // Returns true if the saved result is current and stands in for a
+    // check; otherwise one starts right away and settled() follows. Nothing
+    // is scheduled.
+    bool checkOnce(const EngineConfig &newConfig, bool force) {
+        config = newConfig;
+        updateCheck->setLimits(config.checkLimits);
+        if (!force && restoreSnapshot()) return true;
+        checkScheduler->request(force ? CheckScheduler::Trigger::Manual : CheckScheduler::Trigger::Startup);
+        return false;
+    }
+
+    bool isChecking() const override {
+        return updateCheck->isRunning() || checkScheduler->isWaitingForLock() || waitingForSession;
+    }
+
+    void requestCheck(CheckScheduler::Trigger trigger) override {
+        if (!detected.isSupported()) return;
+        checkScheduler->request(trigger);
+    }
+
+    void cancelCheck() override {
+        if (waitingForSession) {
+            stopWaitingForSession();
+            onCheckCanceled();
+        } else {
+            checkScheduler->cancel();
+        }
+        sourceChecks->cancel();
+    }
+
+    void setConfig(const EngineConfig &newConfig) override {
+        config = newConfig;
+        updateCheck->setLimits(config.checkLimits);
+
+        // Updates of a source no longer checked go away right away
+        bool sourceDropped = false;
+        for (auto it = extraUpdates.begin(); it != extraUpdates.end();) {
+            if (config.extraSources.contains(sourceName(it.key()))) {
+                ++it;
+            } else {
+                it = extraUpdates.erase(it);
+                sourceDropped = true;
+            }
+        }
+        if (sourceDropped && hasResult()) {
+            DiagnosticSample sample;
+            sample.operation = "sources";
+            applyUpdates(sample);
+        }
+        applySchedule();
+    }
+
+    void reportInstallProgress(const InstallProgress &progress) override {
+        emit installProgress(progress);
+    }
+
+signals:
+    // The system check and every extra source it started have reported
+    void settled();
+
+private slots:
+    // Started by the scheduler only
+    void runCheck(CheckScheduler::Trigger trigger) {
+        // Joins the check of the session being waited for
+        if (waitingForSession) return;
+
+        // Sources first: a published system result finishes the round at once
+        emit checkStarted();
+        sourceChecks->start(enabledSources(), config.checkLimits);
+        startSystemCheck(trigger);
+    }
+
+    // The claim was given up or a result published
+    void retryAfterSession() {
+        if (!waitingForSession) return;
+
+        // A check of the other session cannot outlast its timeout by much
+        bool overdue = sessionWait.elapsed() > qint64(config.checkLimits.timeoutSec + 30) * 1000;
+        if (useSharedResult(sessionWaitStart)) return;
+        if (!overdue && sharedCache.claim() == SharedCheckCache::Claim::Taken) return;
+
+        stopWaitingForSession();
+        startLocalCheck();
+    }
+
+    void onCheckCanceled() {
+        sharedCache.release();
+
+        DiagnosticSample sample = checkSample();
+        sample.result = "canceled";
+        log.record(sample);
+        emit checkCanceled();
+        emitIfSettled();
+    }
+
+    void onCheckFinished(const UpdateList &updates, const QByteArray &errorData, int exitCode) {
+        checkScheduler->markChecked();
+        DiagnosticSample sample = checkSample();
+        if (nativeCheckRunning || updateCheck->timing().bytes >= TrimThreshold) trimWhenDone();
+        sample.addCounter("updates", updates.count());
+        sample.addCounter("exit_code", exitCode);
+
+        // The package manager's own tool still works when its databases
+        // cannot be read directly
+        if (nativeCheckRunning && !errorData.isEmpty()) {
+            sample.result = "error: " + QString::fromUtf8(errorData).trimmed();
+            log.record(sample);
+            startCommandCheck();
+            return;
+        }
+
+        QString error = QString::fromUtf8(detected.filterError(errorData)).trimmed();
+        if (!error.isEmpty()) {
+            // Another session may try now; a retry claims the check again
+            sharedCache.release();
+
+            // Lost a race with the package manager taking its lock
+            if (checkScheduler->retryIfLocked()) {
+                sample.result = "locked";
+                log.record(sample);
+                return;
+            }
+
+            sample.result = "error: " + error;
+            log.record(sample);
+            emit checkFinished(error);
+            emitIfSettled();
+            return;
+        }
+
+        systemUpdates = updates.compacted();
+        sharedCache.publish(claimedFingerprints, systemUpdates);
+        applyUpdates(sample);
+        emit checkFinished(QString());
+        emitIfSettled();
+    }
+
+    void onSourceFinished(UpdateSource source, const UpdateList &updates, const QByteArray &error) {
+        DiagnosticSample sample;
+        sample.operation = "check";
+        sample.detail = sourceName(source);
+        sample.addPhase("total", sourceChecks->timing(source).totalNs);
+        sample.addCounter("updates", updates.count());
+
+        // A source that failed keeps showing what it reported last
+        if (!error.isEmpty()) {
+            sample.result = "error: " + QString::fromUtf8(error);
+            log.record(sample);
+            emitIfSettled();
+            return;
+        }
+        extraUpdates.insert(source, updates.compacted());
+
+        // Shown right away with the system updates known so far, so a
+        // system check that fails, is canceled or waits for the lock never
+        // holds a source back
+        applyUpdates(sample);
+        emitIfSettled();
+    }
+
+private:
+    // Once the raw output and parse buffers of a large check are gone,
+    // which is after the signal that carried them returns
+    void trimWhenDone() {
+        if (trimPending) return;
+        trimPending = true;
+        QTimer::singleShot(0, this, [this]() {
+            trimPending = false;
+
+            DiagnosticSample sample;
+            sample.operation = "idle";
+            sample.detail = "trim";
+            sample.addCounter("rss_before_kb", residentSetKb());
+            QElapsedTimer trimTimer;
+            trimTimer.start();
+            trimHeap();
+            sample.addPhase("trim", trimTimer.nsecsElapsed());
+            sample.addCounter("rss_kb", residentSetKb());
+            log.record(sample);
+        });
+    }
+
+    void emitIfSettled() {
+        if (!isChecking() && !sourceChecks->isRunning()) emit settled();
+    }
+
+    // Takes the result another session published if it is current, waits
+    // for the session checking right now, or checks and publishes. A manual
+    // check asks for a fresh answer and skips the published one.
+    void startSystemCheck(CheckScheduler::Trigger trigger) {
+        if (sharedCache.isAvailable()) {
+            if (trigger != CheckScheduler::Trigger::Manual && useSharedResult(QDateTime())) return;
+            if (sharedCache.claim() == SharedCheckCache::Claim::Taken) {
+                waitForSession();
+                return;
+            }
+        }
+        startLocalCheck();
+    }
+
+    void startLocalCheck() {
+        claimedFingerprints = DbFingerprint::of(detected.watchPaths());
+        if (config.useNativeCheck && detected.hasNativeCheck()) {
+            nativeCheckRunning = true;
+            UpdateBackend native = detected;
+            updateCheck->startNative([native](QByteArray &error) { return native.nativeCheck(error); });
+        } else {
+            startCommandCheck();
+        }
+    }
+
+    bool useSharedResult(const QDateTime &notBefore) {
+        UpdateSnapshot shared;
+        if (!sharedCache.load(DbFingerprint::of(detected.watchPaths()), maxResultAge(), notBefore, shared)) return false;
+
+        DiagnosticSample sample;
+        sample.operation = "check";
+        sample.detail = detected.name() + " (shared)";
+        sample.addCounter("updates", shared.updates.count());
+        sample.addCounter("age_s", shared.timestamp.secsTo(QDateTime::currentDateTime()));
+        if (waitingForSession) {
+            sample.addPhase("wait", sessionWait.nsecsElapsed());
+            stopWaitingForSession();
+        }
+
+        systemUpdates = shared.updates.compacted();
+        checkScheduler->markChecked();
+        applyUpdates(sample);
+        emit checkFinished(QString());
+        emitIfSettled();
+        return true;
+    }
+
+    // Publishing renames into the directory, which ends the wait early
+    void waitForSession() {
+        waitingForSession = true;
+        sessionWait.start();
+        sessionWaitStart = QDateTime::currentDateTime();
+
+        sessionWatcher = new QFileSystemWatcher({ sharedCache.path() }, this);
+        connect(sessionWatcher, &QFileSystemWatcher::directoryChanged, this, &UpdateEngine::retryAfterSession);
+        sessionPollTimer->start();
+    }
+
+    void stopWaitingForSession() {
+        waitingForSession = false;
+        sessionPollTimer->stop();
+        // May be the sender
+        if (sessionWatcher) sessionWatcher->deleteLater();
+        sessionWatcher = nullptr;
+    }
+
+    void startCommandCheck() {
+        nativeCheckRunning = false;
+        BackendCommand command = detected.checkCommand();
+        updateCheck->start(command.program, command.args, detected.format());
+    }
+
+    // Reports the system updates together with the last result of every
+    // enabled extra source
+    void applyUpdates(DiagnosticSample sample) {
+        UpdateList merged = mergedUpdates();
+        saveSnapshot(merged);
+
+        setUpdates(merged, true, &sample);
+        log.record(sample);
+    }
+
+    UpdateList mergedUpdates() const {
+        UpdateList merged = systemUpdates;
+        for (auto it = extraUpdates.cbegin(); it != extraUpdates.cend(); ++it) merged.append(it.value(), it.key());
+        return merged;
+    }
+
+    QList<ExtraSource> enabledSources() const {
+        QList<ExtraSource> sources = ExtraSource::all();
+        sources.removeIf([this](const ExtraSource &source) { return !config.extraSources.contains(sourceName(source.id)); });
+        return sources;
+    }
+
+    // Phases of the check that just ended; `wait` is the time the package
+    // manager spent after its first byte of output
+    DiagnosticSample checkSample() const {
+        const UpdateCheck::Timing &timing = updateCheck->timing();
+
+        DiagnosticSample sample;
+        sample.operation = "check";
+        sample.detail = detected.name() + (nativeCheckRunning ? " (native)" : " (command)");
+        if (nativeCheckRunning) {
+            sample.addPhase("native", timing.totalNs);
+        } else {
+            sample.addPhase("spawn", timing.spawnNs);
+            sample.addPhase("first_byte", timing.firstByteNs);
+            if (timing.firstByteNs >= 0 && timing.totalNs >= 0) {
+                sample.addPhase("wait", timing.totalNs - timing.firstByteNs - timing.parseNs);
+            }
+            sample.addPhase("parse", timing.parseNs);
+            sample.addCounter("bytes", timing.bytes);
+            sample.addCounter("children_user_cpu_us", timing.childrenUserCpuUs);
+            sample.addCounter("children_system_cpu_us", timing.childrenSystemCpuUs);
+            sample.addCounter("children_max_rss_kb", timing.childrenMaxRssKb);
+            sample.addCounter("timed_out", timing.timedOut);
+        }
+        if (detected.hasStaleLock()) sample.addCounter("stale_lock", 1);
+        sample.addPhase("total", timing.totalNs);
+        return sample;
+    }
+
+    // Applies the saved result of the last check and reports whether it can
+    // stand in for the check on startup
+    bool restoreSnapshot() {
+        if (!detected.isSupported()) return false;
+
+        UpdateSnapshot snapshot;
+        if (!snapshot.load()) return false;
+
+        systemUpdates = snapshot.updates.from(UpdateSource::System).compacted();
+        for (const ExtraSource &source : enabledSources()) {
+            UpdateList updates = snapshot.updates.from(source.id);
+            if (!updates.isEmpty()) extraUpdates.insert(source.id, updates.compacted());
+        }
+        setUpdates(mergedUpdates(), false);
+
+        qint64 age = snapshot.timestamp.msecsTo(QDateTime::currentDateTime());
+        return age >= 0 && age < maxResultAge() && snapshot.fingerprints == DbFingerprint::of(detected.watchPaths());
+    }
+
+    // Repositories can gain updates without the local databases changing,
+    // so a saved result expires like a scheduled check would
+    qint64 maxResultAge() const {
+        return qint64(config.autoCheckEnabled && config.watchDatabases ? config.fallbackCheckInterval
+                                                                      : config.autoCheckInterval) * 60 * 1000;
+    }
+
+    void saveSnapshot(const UpdateList &updates) {
+        UpdateSnapshot snapshot;
+        snapshot.timestamp = QDateTime::currentDateTime();
+        snapshot.fingerprints = DbFingerprint::of(detected.watchPaths());
+        snapshot.updates = updates;
+        snapshot.save();
+    }
+
+    // With database watches active the timer only acts as a slow fallback
+    void applySchedule() {
+        autoCheckTimer->stop();
+        databaseWatcher->stop();
+
+        if (!config.autoCheckEnabled) return;
+
+        if (config.watchDatabases) {
+            databaseWatcher->watch(detected.watchPaths());
+        }
+        int interval = databaseWatcher->isWatching() ? config.fallbackCheckInterval : config.autoCheckInterval;
+        autoCheckTimer->start(interval * 60 * 1000);
+    }
+
+    EngineConfig config;
+    UpdateCheck *updateCheck = nullptr;
+    SourceChecks *sourceChecks = nullptr;
+    CheckScheduler *checkScheduler = nullptr;
+    DatabaseWatcher *databaseWatcher = nullptr;
+    QTimer *autoCheckTimer = nullptr;
+    SharedCheckCache sharedCache;
+    QVector<DbFingerprint> claimedFingerprints;
+    QFileSystemWatcher *sessionWatcher = nullptr;
+    QTimer *sessionPollTimer = nullptr;
+    QElapsedTimer sessionWait;
+    QDateTime sessionWaitStart;
+    bool waitingForSession = false;
+    bool trimPending = false;
+    qint64 detectNs = -1;
+
+    // Output of a command check large enough to be worth trimming after;
+    // native checks read whole databases and always are
+    static constexpr qint64 TrimThreshold = 64 * 1024;
+    bool nativeCheckRunning = false;
+    UpdateList systemUpdates;
+    QMap<UpdateSource, UpdateList> extraUpdates;
+};
+
+#endif // UPDATEENGINE_H
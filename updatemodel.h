@@ -0,0 +1,194 @@
+#ifndef UPDATEMODEL_H
+#define UPDATEMODEL_H
+
+#include <QAbstractTableModel>
+#include <QByteArray>
+#include <QFutureWatcher>
+#include <QVector>
+#include <QtConcurrent>
+
+#include <algorithm>
+#include <numeric>
+#include <string_view>
+
+#include "updaterecord.h"
+
+// The pending updates as a table for a view. Cells are decoded only when
+// the view asks for them, so the cost of showing the list does not depend
+// on its length. Rows are reached through a map that is empty as long as
+// the list is neither sorted nor filtered; filtering large lists runs on
+// the thread pool.
+class UpdateTableModel : public QAbstractTableModel {
+    Q_OBJECT
+public:
+    enum Column { Name, OldVersion, NewVersion, Repo, Source, Staged, ColumnCount };
+
+    // Lists up to this size are filtered without leaving the GUI thread
+    static constexpr int SyncFilterLimit = 2000;
+
+    UpdateTableModel(const UpdateList &updates, QObject *parent = nullptr)
+        : QAbstractTableModel(parent), updates(updates) {
+        connect(&filterWatcher, &QFutureWatcher<QVector<int>>::finished, this, &UpdateTableModel::filterFinished);
+    }
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override {
+        if (parent.isValid()) return 0;
+        return isIdentity() ? updates.count() : rowMap.size();
+    }
+
+    int columnCount(const QModelIndex &parent = QModelIndex()) const override {
+        return parent.isValid() ? 0 : ColumnCount;
+    }
+
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override {
+        if (!index.isValid() || role != Qt::DisplayRole) return QVariant();
+        int record = recordAt(index.row());
+        if (index.column() == Staged) return isStaged(record) ? QString("downloaded") : QString();
+        if (index.column() == Source) return QString(sourceName(updates.at(record).source));
+        return updates.text(field(updates.at(record), index.column()));
+    }
+
+    // Which records have their package downloaded ahead, by record index
+    void setStaged(const QVector<bool> &flags) {
+        staged = flags;
+        if (rowCount() > 0) emit dataChanged(index(0, Staged), index(rowCount() - 1, Staged));
+    }
+
+    QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override {
+        if (orientation != Qt::Horizontal || role != Qt::DisplayRole) return QVariant();
+        switch (section) {
+        case Name: return QString("Package");
+        case OldVersion: return QString("Installed");
+        case NewVersion: return QString("Available");
+        case Repo: return QString("Repository");
+        case Source: return QString("Source");
+        case Staged: return QString("Staged");
+        }
+        return QVariant();
+    }
+
+    void sort(int column, Qt::SortOrder order = Qt::AscendingOrder) override {
+        emit layoutAboutToBeChanged();
+
+        // Selection and current index follow their records to the new rows;
+        // the records are looked up while the rows still map the old way
+        const QModelIndexList before = persistentIndexList();
+        QVector<int> records;
+        records.reserve(before.size());
+        for (const QModelIndex &index : before) records.append(recordAt(index.row()));
+
+        sorted.resize(updates.count());
+        std::iota(sorted.begin(), sorted.end(), 0);
+        std::stable_sort(sorted.begin(), sorted.end(), [this, column, order](int a, int b) {
+            if (column == Staged) return order == Qt::AscendingOrder ? isStaged(a) < isStaged(b) : isStaged(b) < isStaged(a);
+            if (column == Source) {
+                UpdateSource x = updates.at(a).source, y = updates.at(b).source;
+                return order == Qt::AscendingOrder ? x < y : y < x;
+            }
+            std::string_view x = updates.view(field(updates.at(a), column));
+            std::string_view y = updates.view(field(updates.at(b), column));
+            return order == Qt::AscendingOrder ? x < y : y < x;
+        });
+
+        rowMap = sorted;
+        if (!pattern.isEmpty()) rowMap = matching(updates, sorted, pattern);
+
+        QVector<int> rowOf(updates.count(), -1);
+        for (int row = 0; row < rowMap.size(); ++row) rowOf[rowMap.at(row)] = row;
+        QModelIndexList after;
+        after.reserve(before.size());
+        for (int i = 0; i < before.size(); ++i) {
+            int row = rowOf.at(records.at(i));
+            after.append(row < 0 ? QModelIndex() : createIndex(row, before.at(i).column()));
+        }
+        changePersistentIndexList(before, after);
+
+        emit layoutChanged();
+
+        // A filter still running works on the old order
+        if (filterWatcher.isRunning()) startFilter(pendingPattern);
+    }
+
+    // Shows only packages whose name contains `text`, ignoring case
+    void setFilter(const QString &text) {
+        startFilter(text.trimmed().toUtf8().toLower());
+    }
+
+signals:
+    void filtered(int rows);
+
+private slots:
+    void filterFinished() {
+        if (filterGeneration != generation) return;
+        applyFilter(pendingPattern, filterWatcher.result());
+    }
+
+private:
+    static UpdateField field(const UpdateRecord &record, int column) {
+        switch (column) {
+        case OldVersion: return record.oldVersion;
+        case NewVersion: return record.newVersion;
+        case Repo: return record.repo;
+        default: return record.name;
+        }
+    }
+
+    static bool containsIgnoreCase(std::string_view haystack, std::string_view needle) {
+        auto lower = [](char c) { return c >= 'A' && c <= 'Z' ? char(c + 32) : c; };
+        auto it = std::search(haystack.begin(), haystack.end(), needle.begin(), needle.end(),
+                              [&lower](char a, char b) { return lower(a) == b; });
+        return it != haystack.end() || needle.empty();
+    }
+
+    // Rows of `order` (all records when empty) whose name contains `needle`
+    static QVector<int> matching(const UpdateList &list, const QVector<int> &order, const QByteArray &needle) {
+        std::string_view n(needle.constData(), std::size_t(needle.size()));
+        QVector<int> rows;
+        int count = order.isEmpty() ? list.count() : order.size();
+        for (int i = 0; i < count; ++i) {
+            int record = order.isEmpty() ? i : order.at(i);
+            if (containsIgnoreCase(list.view(list.at(record).name), n)) rows.append(record);
+        }
+        return rows;
+    }
+
+    void startFilter(const QByteArray &needle) {
+        ++generation;
+
+        if (updates.count() <= SyncFilterLimit || needle.isEmpty()) {
+            applyFilter(needle, needle.isEmpty() ? QVector<int>() : matching(updates, sorted, needle));
+            return;
+        }
+
+        // The copies are shallow; the result is dropped if the filter or
+        // the order has changed again by the time it arrives
+        pendingPattern = needle;
+        filterGeneration = generation;
+        filterWatcher.setFuture(QtConcurrent::run(
+            [list = updates, order = sorted, needle]() { return matching(list, order, needle); }));
+    }
+
+    void applyFilter(const QByteArray &needle, const QVector<int> &rows) {
+        beginResetModel();
+        pattern = needle;
+        rowMap = pattern.isEmpty() ? sorted : rows;
+        endResetModel();
+        emit filtered(rowCount());
+    }
+
+    bool isStaged(int record) const { return record < staged.size() && staged.at(record); }
+    bool isIdentity() const { return sorted.isEmpty() && pattern.isEmpty(); }
+    int recordAt(int row) const { return isIdentity() ? row : rowMap.at(row); }
+
+    UpdateList updates;
+    QVector<int> sorted;        // all records in sort order, empty if unsorted
+    QVector<int> rowMap;        // visible rows, unused while isIdentity()
+    QVector<bool> staged;
+    QByteArray pattern;         // filter the rows currently reflect
+    QByteArray pendingPattern;  // filter being computed on the thread pool
+    int generation = 0;
+    int filterGeneration = 0;
+    QFutureWatcher<QVector<int>> filterWatcher;
+};
+
+#endif // UPDATEMODEL_H
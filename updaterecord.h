@@ -0,0 +1,495 @@
+#ifndef UPDATERECORD_H
+#define UPDATERECORD_H
+
+#include <QByteArray>
+#include <QByteArrayList>
+#include <QHash>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QString>
+#include <QVector>
+
+#include <cstring>
+#include <string_view>
+#include <unordered_map>
+
+// A field of an update record, stored as a byte range into the buffer the
+// record was parsed from rather than as its own string.
+struct UpdateField {
+    quint32 offset = 0;
+    quint32 length = 0;
+
+    bool operator==(const UpdateField &other) const = default;
+};
+
+// Where an update comes from; everything but System is optional
+enum class UpdateSource : quint32 {
+    System,
+    Flatpak,
+    Snap,
+    Aur,
+    Firmware
+};
+
+inline const char *sourceName(UpdateSource source) {
+    switch (source) {
+    case UpdateSource::System: return "system";
+    case UpdateSource::Flatpak: return "flatpak";
+    case UpdateSource::Snap: return "snap";
+    case UpdateSource::Aur: return "aur";
+    case UpdateSource::Firmware: return "firmware";
+    }
+    return "";
+}
+
+// System for names it does not know
+inline UpdateSource sourceFromName(std::string_view name) {
+    for (UpdateSource source : { UpdateSource::Flatpak, UpdateSource::Snap, UpdateSource::Aur, UpdateSource::Firmware }) {
+        if (name == sourceName(source)) return source;
+    }
+    return UpdateSource::System;
+}
+
+struct UpdateRecord {
+    UpdateField name;
+    UpdateField oldVersion;
+    UpdateField newVersion;
+    UpdateField repo;
+    UpdateField arch;
+    UpdateSource source = UpdateSource::System;
+
+    bool operator==(const UpdateRecord &other) const = default;
+};
+
+// Parsed result of a check: the raw package manager output plus one
+// compact record per pending update pointing into it.
+class UpdateList {
+public:
+    int count() const { return records.size(); }
+    bool isEmpty() const { return records.isEmpty(); }
+
+    void clear() {
+        buffer.clear();
+        records.clear();
+    }
+
+    std::string_view view(const UpdateField &field) const {
+        return std::string_view(buffer.constData() + field.offset, field.length);
+    }
+
+    QString text(const UpdateField &field) const {
+        return QString::fromUtf8(buffer.constData() + field.offset, field.length);
+    }
+
+    const UpdateRecord &at(int i) const { return records.at(i); }
+
+    // One "name old -> new (repo)" line per update
+    QString toText() const {
+        QString text;
+        for (const UpdateRecord &record : records) {
+            text += this->text(record.name);
+            if (record.oldVersion.length) {
+                text += ' ' + this->text(record.oldVersion) + " ->";
+            }
+            text += ' ' + this->text(record.newVersion);
+            if (record.repo.length) {
+                text += " (" + this->text(record.repo) + ')';
+            }
+            text += '\n';
+        }
+        return text;
+    }
+
+    // Adds a record for updates that were not parsed from command output
+    void append(const QByteArray &name, const QByteArray &oldVersion, const QByteArray &newVersion,
+                const QByteArray &repo = QByteArray(), const QByteArray &arch = QByteArray()) {
+        UpdateRecord record;
+        record.name = appendField(name);
+        record.oldVersion = appendField(oldVersion);
+        record.newVersion = appendField(newVersion);
+        record.repo = appendField(repo);
+        record.arch = appendField(arch);
+        records.append(record);
+    }
+
+    // Adds all records of `other`, tagged as coming from `source`
+    void append(const UpdateList &other, UpdateSource source) {
+        quint32 base = quint32(buffer.size());
+        buffer.append(other.buffer);
+        records.reserve(records.size() + other.records.size());
+        for (UpdateRecord record : other.records) {
+            for (UpdateField *field : { &record.name, &record.oldVersion, &record.newVersion, &record.repo, &record.arch }) {
+                field->offset += base;
+            }
+            record.source = source;
+            records.append(record);
+        }
+    }
+
+    // A copy holding only the bytes the records use, each distinct string
+    // once: repositories, architectures and versions repeated across
+    // records share one copy, and the command output around the fields
+    // stays behind. Kept results are compacted so that what lives between
+    // checks is one exactly sized block per list.
+    UpdateList compacted() const {
+        qsizetype size = 0;
+        for (const UpdateRecord &record : records) {
+            size += record.name.length + record.oldVersion.length + record.newVersion.length +
+                    record.repo.length + record.arch.length;
+        }
+
+        UpdateList list;
+        list.buffer.reserve(size);
+        list.records.reserve(records.size());
+        std::unordered_map<std::string_view, quint32> interned;
+        interned.reserve(std::size_t(records.size()) * 2);
+        for (UpdateRecord record : records) {
+            for (UpdateField *field : { &record.name, &record.oldVersion, &record.newVersion, &record.repo, &record.arch }) {
+                std::string_view text = view(*field);
+                auto [it, inserted] = interned.try_emplace(text, quint32(list.buffer.size()));
+                if (inserted) list.buffer.append(text.data(), qsizetype(text.size()));
+                field->offset = it->second;
+            }
+            list.records.append(record);
+        }
+        list.buffer.squeeze();
+        return list;
+    }
+
+    bool operator==(const UpdateList &other) const {
+        return records == other.records && buffer == other.buffer;
+    }
+
+    // The records from `source`, sharing this list's buffer
+    UpdateList from(UpdateSource source) const {
+        UpdateList list;
+        list.buffer = buffer;
+        for (const UpdateRecord &record : records) {
+            if (record.source == source) list.records.append(record);
+        }
+        return list;
+    }
+
+    QByteArray buffer;
+    QVector<UpdateRecord> records;
+
+private:
+    UpdateField appendField(const QByteArray &bytes) {
+        UpdateField field{ quint32(buffer.size()), quint32(bytes.size()) };
+        buffer.append(bytes);
+        return field;
+    }
+};
+
+// The pending updates of one check as a hashed set of (package, new
+// version), used to tell what changed between two checks. Packages are
+// keyed by name and, where the backend reports it, architecture.
+class UpdateSet {
+public:
+    UpdateSet() = default;
+
+    explicit UpdateSet(const UpdateList &list) {
+        versions.reserve(list.count());
+        for (const UpdateRecord &record : list.records) {
+            versions.insert(key(list, record), toBytes(list.view(record.newVersion)));
+        }
+    }
+
+    int count() const { return versions.size(); }
+    bool isEmpty() const { return versions.isEmpty(); }
+
+    static QByteArray key(const UpdateList &list, const UpdateRecord &record) {
+        QByteArray package = toBytes(list.view(record.name));
+        if (record.source != UpdateSource::System) package.prepend(QByteArray(sourceName(record.source)) + '/');
+        if (record.arch.length) package += ':' + toBytes(list.view(record.arch));
+        return package;
+    }
+
+private:
+    friend struct UpdateDelta;
+
+    static QByteArray toBytes(std::string_view s) { return QByteArray(s.data(), qsizetype(s.size())); }
+
+    QHash<QByteArray, QByteArray> versions;     // package -> new version
+};
+
+// What changed between two checks. Packages whose pending version moved on
+// count as bumped rather than as removed and added.
+struct UpdateDelta {
+    QByteArrayList added;
+    QByteArrayList removed;
+    QByteArrayList bumped;
+
+    static UpdateDelta between(const UpdateSet &before, const UpdateSet &after) {
+        UpdateDelta delta;
+        for (auto it = after.versions.constBegin(); it != after.versions.constEnd(); ++it) {
+            auto previous = before.versions.constFind(it.key());
+            if (previous == before.versions.constEnd()) {
+                delta.added.append(it.key());
+            } else if (previous.value() != it.value()) {
+                delta.bumped.append(it.key());
+            }
+        }
+        for (auto it = before.versions.constBegin(); it != before.versions.constEnd(); ++it) {
+            if (!after.versions.contains(it.key())) delta.removed.append(it.key());
+        }
+        return delta;
+    }
+
+    bool isEmpty() const { return added.isEmpty() && removed.isEmpty() && bumped.isEmpty(); }
+
+    // Something the user has not been told about yet
+    bool hasNewUpdates() const { return !added.isEmpty() || !bumped.isEmpty(); }
+};
+
+enum class UpdateFormat {
+    Checkupdates,   // name oldver -> newver
+    Apt,            // name/suite newver arch [upgradable from: oldver]
+    Pkcon,          // Info<TAB>name-version.arch (repo)
+    Flatpak,        // application<TAB>version<TAB>origin
+    Snap,           // name version rev size publisher notes, after a header
+    Fwupd           // fwupdmgr get-updates --json, parsed as a whole
+};
+
+namespace UpdateLine {
+
+inline std::string_view trim(std::string_view s) {
+    while (!s.empty() && (s.front() == ' ' || s.front() == '\t' || s.front() == '\r')) s.remove_prefix(1);
+    while (!s.empty() && (s.back() == ' ' || s.back() == '\t' || s.back() == '\r')) s.remove_suffix(1);
+    return s;
+}
+
+// Splits off the next space separated token, leaving the rest in `s`
+inline std::string_view nextToken(std::string_view &s) {
+    std::size_t start = s.find_first_not_of(' ');
+    if (start == std::string_view::npos) {
+        s = {};
+        return {};
+    }
+    s.remove_prefix(start);
+    std::size_t end = s.find(' ');
+    std::string_view token = s.substr(0, end);
+    s.remove_prefix(end == std::string_view::npos ? s.size() : end);
+    return token;
+}
+
+// `part` must be a view into `line`; the resulting field is relative to `base`
+inline UpdateField fieldOf(std::string_view line, std::string_view part, quint32 base) {
+    return UpdateField{ base + quint32(part.data() - line.data()), quint32(part.size()) };
+}
+
+inline bool parseCheckupdates(std::string_view line, quint32 base, UpdateRecord &record) {
+    std::string_view rest = line;
+    std::string_view name = nextToken(rest);
+    std::string_view oldVersion = nextToken(rest);
+    std::string_view arrow = nextToken(rest);
+    std::string_view newVersion = nextToken(rest);
+    if (name.empty() || newVersion.empty() || arrow != "->") return false;
+
+    // Held back by IgnorePkg/IgnoreGroup; -Su will not install it
+    if (nextToken(rest) == "[ignored]") return false;
+
+    record = UpdateRecord();
+    record.name = fieldOf(line, name, base);
+    record.oldVersion = fieldOf(line, oldVersion, base);
+    record.newVersion = fieldOf(line, newVersion, base);
+    return true;
+}
+
+inline bool parseApt(std::string_view line, quint32 base, UpdateRecord &record) {
+    std::string_view rest = line;
+    std::string_view nameAndRepo = nextToken(rest);
+    std::string_view newVersion = nextToken(rest);
+    std::string_view arch = nextToken(rest);
+
+    // Skips "Listing..." and anything else that is not a package line
+    std::size_t slash = nameAndRepo.find('/');
+    if (slash == std::string_view::npos || slash == 0 || newVersion.empty()) return false;
+
+    record = UpdateRecord();
+    record.name = fieldOf(line, nameAndRepo.substr(0, slash), base);
+    record.repo = fieldOf(line, nameAndRepo.substr(slash + 1), base);
+    record.newVersion = fieldOf(line, newVersion, base);
+    record.arch = fieldOf(line, arch, base);
+
+    constexpr std::string_view marker = "[upgradable from: ";
+    std::size_t from = rest.find(marker);
+    if (from != std::string_view::npos) {
+        std::string_view oldVersion = rest.substr(from + marker.size());
+        oldVersion = oldVersion.substr(0, oldVersion.find(']'));
+        record.oldVersion = fieldOf(line, oldVersion, base);
+    }
+    return true;
+}
+
+inline bool isKnownArch(std::string_view s) {
+    constexpr std::string_view arches[] = {
+        "all", "amd64", "arm64", "armel", "armhf", "i386", "i686", "mips64el",
+        "noarch", "ppc64el", "riscv64", "s390x", "x86_64", "aarch64"
+    };
+    for (std::string_view arch : arches) {
+        if (s == arch) return true;
+    }
+    return false;
+}
+
+inline bool parsePkcon(std::string_view line, quint32 base, UpdateRecord &record) {
+    // Status and progress lines carry no tab separated package id
+    std::size_t tab = line.find('\t');
+    if (tab == std::string_view::npos) return false;
+
+    std::string_view id = trim(line.substr(tab + 1));
+    std::string_view repo;
+    if (!id.empty() && id.back() == ')') {
+        std::size_t open = id.rfind(" (");
+        if (open == std::string_view::npos) return false;
+        repo = id.substr(open + 2, id.size() - open - 3);
+        id = id.substr(0, open);
+    }
+
+    std::string_view arch;
+    std::size_t dot = id.rfind('.');
+    if (dot != std::string_view::npos && isKnownArch(id.substr(dot + 1))) {
+        arch = id.substr(dot + 1);
+        id = id.substr(0, dot);
+    }
+
+    // Package names may contain dashes; the version starts at the first
+    // dash followed by a digit
+    std::size_t dash = 0;
+    while ((dash = id.find('-', dash)) != std::string_view::npos) {
+        if (dash + 1 < id.size() && id[dash + 1] >= '0' && id[dash + 1] <= '9') break;
+        ++dash;
+    }
+    if (dash == std::string_view::npos || dash == 0) return false;
+
+    record = UpdateRecord();
+    record.name = fieldOf(line, id.substr(0, dash), base);
+    record.newVersion = fieldOf(line, id.substr(dash + 1), base);
+    record.repo = fieldOf(line, repo, base);
+    record.arch = fieldOf(line, arch, base);
+    return true;
+}
+
+inline bool parseFlatpak(std::string_view line, quint32 base, UpdateRecord &record) {
+    std::size_t tab = line.find('\t');
+    std::string_view application = line.substr(0, tab);
+    if (application.empty() || application.find('.') == std::string_view::npos) return false;
+
+    std::string_view rest = tab == std::string_view::npos ? std::string_view() : line.substr(tab + 1);
+    tab = rest.find('\t');
+    std::string_view version = rest.substr(0, tab);
+    std::string_view origin = tab == std::string_view::npos ? std::string_view() : rest.substr(tab + 1);
+
+    record = UpdateRecord();
+    record.name = fieldOf(line, application, base);
+    record.newVersion = fieldOf(line, trim(version), base);
+    record.repo = fieldOf(line, trim(origin), base);
+    return true;
+}
+
+inline bool parseSnap(std::string_view line, quint32 base, UpdateRecord &record) {
+    std::string_view rest = line;
+    std::string_view name = nextToken(rest);
+    std::string_view version = nextToken(rest);
+    if (name.empty() || version.empty() || name == "Name") return false;
+
+    record = UpdateRecord();
+    record.name = fieldOf(line, name, base);
+    record.newVersion = fieldOf(line, version, base);
+    return true;
+}
+
+inline bool parse(UpdateFormat format, std::string_view line, quint32 base, UpdateRecord &record) {
+    switch (format) {
+    case UpdateFormat::Checkupdates: return parseCheckupdates(line, base, record);
+    case UpdateFormat::Apt: return parseApt(line, base, record);
+    case UpdateFormat::Pkcon: return parsePkcon(line, base, record);
+    case UpdateFormat::Flatpak: return parseFlatpak(line, base, record);
+    case UpdateFormat::Snap: return parseSnap(line, base, record);
+    case UpdateFormat::Fwupd: return false;
+    }
+    return false;
+}
+
+} // namespace UpdateLine
+
+// Turns package manager output into an UpdateList as it streams in. Chunks
+// are appended to the list's buffer and every completed line is parsed in
+// place, so no per-line strings are allocated.
+class UpdateParser {
+public:
+    UpdateParser(UpdateFormat format = UpdateFormat::Checkupdates) : format(format) {}
+
+    void reset(UpdateFormat newFormat) {
+        format = newFormat;
+        list.clear();
+        parsed = 0;
+    }
+
+    void feed(const QByteArray &chunk) {
+        list.buffer.append(chunk);
+        if (format != UpdateFormat::Fwupd) parseLines(false);
+    }
+
+    // Parses a trailing line that was not terminated by a newline
+    void finish() {
+        if (format == UpdateFormat::Fwupd) {
+            parseFwupd();
+            return;
+        }
+        parseLines(true);
+    }
+
+    const UpdateList &result() const { return list; }
+
+    UpdateList take() {
+        UpdateList taken = std::move(list);
+        list = UpdateList();
+        parsed = 0;
+        return taken;
+    }
+
+private:
+    // One record per device with a newer release; the first release listed
+    // is the newest
+    void parseFwupd() {
+        QJsonObject root = QJsonDocument::fromJson(list.buffer).object();
+        const QJsonArray devices = root.value("Devices").toArray();
+        for (const QJsonValue &value : devices) {
+            QJsonObject device = value.toObject();
+            QJsonArray releases = device.value("Releases").toArray();
+            if (releases.isEmpty()) continue;
+            QJsonObject release = releases.first().toObject();
+            list.append(device.value("Name").toString().toUtf8(), device.value("Version").toString().toUtf8(),
+                        release.value("Version").toString().toUtf8(), release.value("RemoteId").toString().toUtf8());
+        }
+    }
+
+    void parseLines(bool final) {
+        const char *data = list.buffer.constData();
+        const qsizetype size = list.buffer.size();
+
+        while (parsed < size) {
+            const char *end = static_cast<const char *>(std::memchr(data + parsed, '\n', size - parsed));
+            if (!end && !final) break;
+
+            qsizetype lineEnd = end ? end - data : size;
+            std::string_view line(data + parsed, lineEnd - parsed);
+            if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+
+            UpdateRecord record;
+            if (UpdateLine::parse(format, line, quint32(parsed), record)) {
+                list.records.append(record);
+            }
+            parsed = lineEnd + 1;
+        }
+    }
+
+    UpdateFormat format;
+    UpdateList list;
+    qsizetype parsed = 0;
+};
+
+#endif // UPDATERECORD_H
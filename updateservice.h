@@ -0,0 +1,280 @@
+#ifndef UPDATESERVICE_H
+#define UPDATESERVICE_H
+
+#include <QDBusAbstractAdaptor>
+#include <QDBusArgument>
+#include <QDBusConnection>
+#include <QDBusConnectionInterface>
+#include <QDBusMessage>
+#include <QDBusMetaType>
+#include <QDBusPendingCallWatcher>
+#include <QDBusPendingReply>
+#include <QDBusServiceWatcher>
+#include <QDBusVariant>
+#include <QList>
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QVariantList>
+
+#include "installprogress.h"
+#include "updateengine.h"
+#include "updaterecord.h"
+
+// The engine on the session bus, so the tray, scripts and widgets of a
+// session share one set of checks and one result instead of each running
+// their own
+namespace UpdateService {
+
+inline const QString Name = "org.claudemods.UpdateChecker";
+inline const QString Path = "/UpdateChecker";
+inline const QString Interface = "org.claudemods.UpdateChecker";
+
+inline bool isRunning() {
+    QDBusConnection bus = QDBusConnection::sessionBus();
+    return bus.isConnected() && bus.interface()->isServiceRegistered(Name);
+}
+
+inline const char *phaseName(InstallProgress::Phase phase) {
+    switch (phase) {
+    case InstallProgress::Preparing: return "preparing";
+    case InstallProgress::Downloading: return "downloading";
+    case InstallProgress::Installing: return "installing";
+    case InstallProgress::Finished: return "finished";
+    }
+    return "";
+}
+
+inline InstallProgress::Phase phaseFromName(const QString &name) {
+    if (name == "downloading") return InstallProgress::Downloading;
+    if (name == "installing") return InstallProgress::Installing;
+    if (name == "finished") return InstallProgress::Finished;
+    return InstallProgress::Preparing;
+}
+
+} // namespace UpdateService
+
+// One pending update as sent over the bus, (ssssss)
+struct DBusUpdate {
+    QString name;
+    QString oldVersion;
+    QString newVersion;
+    QString repo;
+    QString arch;
+    QString source;
+
+    static QList<DBusUpdate> fromList(const UpdateList &list) {
+        QList<DBusUpdate> updates;
+        updates.reserve(list.count());
+        for (const UpdateRecord &record : list.records) {
+            updates.append({ list.text(record.name), list.text(record.oldVersion), list.text(record.newVersion),
+                             list.text(record.repo), list.text(record.arch), QString(sourceName(record.source)) });
+        }
+        return updates;
+    }
+
+    static UpdateList toList(const QList<DBusUpdate> &updates) {
+        UpdateList list;
+        for (const DBusUpdate &update : updates) {
+            list.append(update.name.toUtf8(), update.oldVersion.toUtf8(), update.newVersion.toUtf8(),
+                        update.repo.toUtf8(), update.arch.toUtf8());
+            list.records.last().source = sourceFromName(update.source.toStdString());
+        }
+        return list;
+    }
+};
+Q_DECLARE_METATYPE(DBusUpdate)
+
+inline QDBusArgument &operator<<(QDBusArgument &argument, const DBusUpdate &update) {
+    argument.beginStructure();
+    argument << update.name << update.oldVersion << update.newVersion << update.repo << update.arch << update.source;
+    argument.endStructure();
+    return argument;
+}
+
+inline const QDBusArgument &operator>>(const QDBusArgument &argument, DBusUpdate &update) {
+    argument.beginStructure();
+    argument >> update.name >> update.oldVersion >> update.newVersion >> update.repo >> update.arch >> update.source;
+    argument.endStructure();
+    return argument;
+}
+
+namespace UpdateService {
+
+inline void registerTypes() {
+    qDBusRegisterMetaType<DBusUpdate>();
+    qDBusRegisterMetaType<QList<DBusUpdate>>();
+}
+
+} // namespace UpdateService
+
+// Exports an UpdateEngine as org.claudemods.UpdateChecker
+class UpdateServiceAdaptor : public QDBusAbstractAdaptor {
+    Q_OBJECT
+    Q_CLASSINFO("D-Bus Interface", "org.claudemods.UpdateChecker")
+    Q_PROPERTY(uint Count READ count)
+    Q_PROPERTY(QString Backend READ backendName)
+    Q_PROPERTY(bool Checking READ checking)
+public:
+    UpdateServiceAdaptor(UpdateEngine *engine) : QDBusAbstractAdaptor(engine), engine(engine) {
+        connect(engine, &UpdateProvider::checkStarted, this, &UpdateServiceAdaptor::CheckStarted);
+        connect(engine, &UpdateProvider::waitingForLock, this, &UpdateServiceAdaptor::WaitingForLock);
+        connect(engine, &UpdateProvider::checkCanceled, this, &UpdateServiceAdaptor::CheckCanceled);
+        connect(engine, &UpdateProvider::checkFinished, this, &UpdateServiceAdaptor::CheckFinished);
+        connect(engine, &UpdateProvider::updatesChanged, this, [this](const UpdateDelta &delta) {
+            auto keys = [](const QByteArrayList &list) {
+                QStringList strings;
+                strings.reserve(list.size());
+                for (const QByteArray &key : list) strings.append(QString::fromUtf8(key));
+                return strings;
+            };
+            emit UpdatesChanged(uint(this->engine->count()), keys(delta.added), keys(delta.removed), keys(delta.bumped));
+        });
+        connect(engine, &UpdateProvider::installProgress, this, [this](const InstallProgress &progress) {
+            emit InstallProgressChanged(progress.percent, UpdateService::phaseName(progress.phase), QString::fromUtf8(progress.package));
+        });
+    }
+
+    uint count() const { return uint(engine->count()); }
+    QString backendName() const { return engine->backend().name(); }
+    bool checking() const { return engine->isChecking(); }
+
+public slots:
+    // The pending updates, system ones first
+    QList<DBusUpdate> Updates() { return DBusUpdate::fromList(engine->updates()); }
+
+    // Starts a check unless one is running, which is then joined. Without
+    // `force` a result younger than a minute is taken as it is. Returns
+    // whether a check is under way; CheckFinished follows if so.
+    bool CheckNow(bool force) {
+        engine->requestCheck(force ? CheckScheduler::Trigger::Manual : CheckScheduler::Trigger::Remote);
+        return engine->isChecking();
+    }
+
+    void Cancel() { engine->cancelCheck(); }
+
+    // After the settings were changed by another process
+    void ReloadConfig() {
+        QSettings().sync();
+        engine->setConfig(EngineConfig::load());
+    }
+
+    // For the client running an install; "finished" also re-checks
+    void ReportInstallProgress(int percent, const QString &phase, const QString &package) {
+        InstallProgress progress;
+        progress.phase = UpdateService::phaseFromName(phase);
+        progress.percent = percent;
+        progress.package = package.toUtf8();
+        engine->reportInstallProgress(progress);
+        if (progress.phase == InstallProgress::Finished) engine->requestCheck(CheckScheduler::Trigger::AfterInstall);
+    }
+
+signals:
+    void CheckStarted();
+    void WaitingForLock(int msec);
+    void CheckCanceled();
+    void CheckFinished(const QString &error);
+    // Package keys as UpdateSet makes them; Updates() has the records
+    void UpdatesChanged(uint count, const QStringList &added, const QStringList &removed, const QStringList &bumped);
+    void InstallProgressChanged(int percent, const QString &phase, const QString &package);
+
+private:
+    UpdateEngine *engine;
+};
+
+// The update daemon seen from a frontend: requests go over the bus and the
+// records are fetched whenever the daemon reports a change. Every call is
+// an asynchronous message; a QDBusInterface would introspect the service
+// synchronously while the tray starts.
+class UpdateServiceClient : public UpdateProvider {
+    Q_OBJECT
+public:
+    UpdateServiceClient(QObject *parent = nullptr)
+        : UpdateProvider(parent),
+          serviceWatcher(UpdateService::Name, QDBusConnection::sessionBus(), QDBusServiceWatcher::WatchForUnregistration) {
+        // Installs and prefetches still run here and need the backend
+        detected = UpdateBackend::detect(OsRelease::load());
+
+        QDBusConnection bus = QDBusConnection::sessionBus();
+        using namespace UpdateService;
+        bus.connect(Name, Path, Interface, "CheckStarted", this, SLOT(onCheckStarted()));
+        bus.connect(Name, Path, Interface, "WaitingForLock", this, SLOT(onWaitingForLock(int)));
+        bus.connect(Name, Path, Interface, "CheckCanceled", this, SLOT(onCheckCanceled()));
+        bus.connect(Name, Path, Interface, "CheckFinished", this, SLOT(onCheckFinished(QString)));
+        bus.connect(Name, Path, Interface, "UpdatesChanged", this, SLOT(fetchUpdates()));
+        connect(&serviceWatcher, &QDBusServiceWatcher::serviceUnregistered, this, &UpdateServiceClient::serviceLost);
+
+        QDBusMessage getChecking = QDBusMessage::createMethodCall(Name, Path, "org.freedesktop.DBus.Properties", "Get");
+        getChecking << Interface << QString("Checking");
+        auto *watcher = new QDBusPendingCallWatcher(bus.asyncCall(getChecking), this);
+        connect(watcher, &QDBusPendingCallWatcher::finished, this, [this](QDBusPendingCallWatcher *pending) {
+            QDBusPendingReply<QDBusVariant> reply = *pending;
+            pending->deleteLater();
+            if (!reply.isError()) checking = reply.value().variant().toBool();
+        });
+        fetchUpdates();
+    }
+
+    bool isChecking() const override { return checking; }
+
+    // The frontend only asks on behalf of the user or after an install
+    void requestCheck(CheckScheduler::Trigger) override { call("CheckNow", { true }); }
+    void cancelCheck() override { call("Cancel"); }
+
+    // The frontend has saved the settings; the daemon reads them again
+    void setConfig(const EngineConfig &) override { call("ReloadConfig"); }
+
+    void reportInstallProgress(const InstallProgress &progress) override {
+        call("ReportInstallProgress", { progress.percent, QString(UpdateService::phaseName(progress.phase)),
+                                        QString::fromUtf8(progress.package) });
+    }
+
+signals:
+    // The daemon quit; the frontend has to check on its own
+    void serviceLost();
+
+private slots:
+    void onCheckStarted() {
+        checking = true;
+        emit checkStarted();
+    }
+
+    void onWaitingForLock(int msec) {
+        checking = true;
+        emit waitingForLock(msec);
+    }
+
+    void onCheckCanceled() {
+        checking = false;
+        emit checkCanceled();
+    }
+
+    void onCheckFinished(const QString &error) {
+        checking = false;
+        emit checkFinished(error);
+    }
+
+    // The first result is what the daemon already had, which this session
+    // may well have been told about before; only later changes announce
+    void fetchUpdates() {
+        auto *watcher = new QDBusPendingCallWatcher(call("Updates"), this);
+        connect(watcher, &QDBusPendingCallWatcher::finished, this, [this](QDBusPendingCallWatcher *pending) {
+            QDBusPendingReply<QList<DBusUpdate>> reply = *pending;
+            pending->deleteLater();
+            if (!reply.isError()) setUpdates(DBusUpdate::toList(reply.value()), hasResult());
+        });
+    }
+
+private:
+    QDBusPendingCall call(const QString &method, const QVariantList &args = {}) {
+        using namespace UpdateService;
+        QDBusMessage message = QDBusMessage::createMethodCall(Name, Path, Interface, method);
+        message.setArguments(args);
+        return QDBusConnection::sessionBus().asyncCall(message);
+    }
+
+    QDBusServiceWatcher serviceWatcher;
+    bool checking = false;
+};
+
+#endif // UPDATESERVICE_H
@@ -0,0 +1,234 @@
+#ifndef VERCMP_H
+#define VERCMP_H
+
+#include <string_view>
+
+// Version ordering as implemented by package managers. Everything works on
+// string views and allocates nothing, so it is safe to call per package.
+// Versions that are compared repeatedly can be split once into an
+// AlpmVersion or DpkgVersion and compared in that form.
+namespace Vercmp {
+
+inline bool isDigit(char c) { return c >= '0' && c <= '9'; }
+inline bool isAlpha(char c) { return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z'); }
+inline bool isAlnum(char c) { return isDigit(c) || isAlpha(c); }
+
+// rpmvercmp() from libalpm: compares alternating numeric and alphabetic
+// segments, treating any run of other characters as a separator
+inline int rpmvercmp(std::string_view a, std::string_view b) {
+    if (a == b) return 0;
+
+    std::size_t one = 0, two = 0;
+    std::size_t ptr1 = 0, ptr2 = 0;
+
+    while (one < a.size() && two < b.size()) {
+        while (one < a.size() && !isAlnum(a[one])) ++one;
+        while (two < b.size() && !isAlnum(b[two])) ++two;
+
+        if (one >= a.size() || two >= b.size()) break;
+
+        // Different separator lengths decide on their own
+        if (one - ptr1 != two - ptr2) return one - ptr1 < two - ptr2 ? -1 : 1;
+
+        ptr1 = one;
+        ptr2 = two;
+
+        bool isNum = isDigit(a[ptr1]);
+        if (isNum) {
+            while (ptr1 < a.size() && isDigit(a[ptr1])) ++ptr1;
+            while (ptr2 < b.size() && isDigit(b[ptr2])) ++ptr2;
+        } else {
+            while (ptr1 < a.size() && isAlpha(a[ptr1])) ++ptr1;
+            while (ptr2 < b.size() && isAlpha(b[ptr2])) ++ptr2;
+        }
+
+        // A numeric segment is always newer than an alphabetic one
+        if (two == ptr2) return isNum ? 1 : -1;
+
+        std::string_view segment1 = a.substr(one, ptr1 - one);
+        std::string_view segment2 = b.substr(two, ptr2 - two);
+
+        if (isNum) {
+            while (!segment1.empty() && segment1.front() == '0') segment1.remove_prefix(1);
+            while (!segment2.empty() && segment2.front() == '0') segment2.remove_prefix(1);
+            if (segment1.size() != segment2.size()) return segment1.size() > segment2.size() ? 1 : -1;
+        }
+
+        int rc = segment1.compare(segment2);
+        if (rc) return rc < 0 ? -1 : 1;
+
+        one = ptr1;
+        two = ptr2;
+    }
+
+    if (one >= a.size() && two >= b.size()) return 0;
+
+    // A remaining alphabetic segment never beats an empty one
+    bool oneEnded = one >= a.size();
+    bool twoAlpha = two < b.size() && isAlpha(b[two]);
+    bool oneAlpha = !oneEnded && isAlpha(a[one]);
+    return (oneEnded && !twoAlpha) || oneAlpha ? -1 : 1;
+}
+
+struct Evr {
+    std::string_view epoch;
+    std::string_view version;
+    std::string_view release;
+    bool hasRelease = false;
+};
+
+// Splits [epoch:]version[-release] the way libalpm's parseEVR() does
+inline Evr splitAlpm(std::string_view evr) {
+    Evr parts;
+    std::size_t s = 0;
+    while (s < evr.size() && isDigit(evr[s])) ++s;
+
+    std::size_t dash = evr.rfind('-');
+    if (dash != std::string_view::npos && dash < s) dash = std::string_view::npos;
+
+    if (s < evr.size() && evr[s] == ':') {
+        parts.epoch = s == 0 ? std::string_view("0") : evr.substr(0, s);
+        ++s;
+    } else {
+        parts.epoch = "0";
+        s = 0;
+    }
+
+    if (dash != std::string_view::npos && dash >= s) {
+        parts.version = evr.substr(s, dash - s);
+        parts.release = evr.substr(dash + 1);
+        parts.hasRelease = true;
+    } else {
+        parts.version = evr.substr(s);
+    }
+    return parts;
+}
+
+// A pacman version split into epoch, version and release once
+struct AlpmVersion {
+    AlpmVersion() = default;
+    explicit AlpmVersion(std::string_view full) : full(full), evr(splitAlpm(full)) {}
+
+    std::string_view full;
+    Evr evr;
+};
+
+inline int alpm(const AlpmVersion &a, const AlpmVersion &b) {
+    if (a.full == b.full) return 0;
+
+    int ret = rpmvercmp(a.evr.epoch, b.evr.epoch);
+    if (ret == 0) {
+        ret = rpmvercmp(a.evr.version, b.evr.version);
+        if (ret == 0 && a.evr.hasRelease && b.evr.hasRelease) {
+            ret = rpmvercmp(a.evr.release, b.evr.release);
+        }
+    }
+    return ret;
+}
+
+// alpm_pkg_vercmp(): <0 if a is older than b, 0 if equal, >0 if newer
+inline int alpm(std::string_view a, std::string_view b) {
+    if (a == b) return 0;
+    return alpm(AlpmVersion(a), AlpmVersion(b));
+}
+
+// Character weight in dpkg's verrevcmp(): letters sort before other
+// symbols and '~' sorts before everything, even the end of the string
+inline int dpkgOrder(char c) {
+    if (isDigit(c)) return 0;
+    if (isAlpha(c)) return c;
+    if (c == '~') return -1;
+    if (c) return (unsigned char)c + 256;
+    return 0;
+}
+
+inline int verrevcmp(std::string_view a, std::string_view b) {
+    std::size_t i = 0, j = 0;
+    auto at = [](std::string_view s, std::size_t k) { return k < s.size() ? s[k] : '\0'; };
+
+    while (i < a.size() || j < b.size()) {
+        int firstDiff = 0;
+
+        while ((i < a.size() && !isDigit(a[i])) || (j < b.size() && !isDigit(b[j]))) {
+            int ac = dpkgOrder(at(a, i));
+            int bc = dpkgOrder(at(b, j));
+            if (ac != bc) return ac - bc;
+            ++i;
+            ++j;
+        }
+
+        while (at(a, i) == '0') ++i;
+        while (at(b, j) == '0') ++j;
+
+        while (isDigit(at(a, i)) && isDigit(at(b, j))) {
+            if (!firstDiff) firstDiff = a[i] - b[j];
+            ++i;
+            ++j;
+        }
+
+        if (isDigit(at(a, i))) return 1;
+        if (isDigit(at(b, j))) return -1;
+        if (firstDiff) return firstDiff;
+    }
+    return 0;
+}
+
+// Splits [epoch:]upstream[-revision] the way dpkg's parseversion() does
+inline Evr splitDpkg(std::string_view version) {
+    Evr parts;
+    std::size_t colon = version.find(':');
+    if (colon != std::string_view::npos) {
+        parts.epoch = version.substr(0, colon);
+        version.remove_prefix(colon + 1);
+    }
+
+    std::size_t dash = version.rfind('-');
+    if (dash != std::string_view::npos) {
+        parts.version = version.substr(0, dash);
+        parts.release = version.substr(dash + 1);
+        parts.hasRelease = true;
+    } else {
+        parts.version = version;
+    }
+    return parts;
+}
+
+inline unsigned long epochValue(std::string_view epoch) {
+    unsigned long value = 0;
+    for (char c : epoch) {
+        if (!isDigit(c)) break;
+        value = value * 10 + (c - '0');
+    }
+    return value;
+}
+
+// A Debian version split into numeric epoch, upstream and revision once
+struct DpkgVersion {
+    DpkgVersion() = default;
+    explicit DpkgVersion(std::string_view full) : full(full), evr(splitDpkg(full)), epoch(epochValue(evr.epoch)) {}
+
+    std::string_view full;
+    Evr evr;
+    unsigned long epoch = 0;
+};
+
+inline int dpkg(const DpkgVersion &a, const DpkgVersion &b) {
+    if (a.full == b.full) return 0;
+    if (a.epoch != b.epoch) return a.epoch < b.epoch ? -1 : 1;
+
+    int ret = verrevcmp(a.evr.version, b.evr.version);
+    if (ret) return ret < 0 ? -1 : 1;
+
+    ret = verrevcmp(a.evr.release, b.evr.release);
+    return ret < 0 ? -1 : (ret > 0 ? 1 : 0);
+}
+
+// dpkg --compare-versions: <0 if a is older than b, 0 if equal, >0 if newer
+inline int dpkg(std::string_view a, std::string_view b) {
+    if (a == b) return 0;
+    return dpkg(DpkgVersion(a), DpkgVersion(b));
+}
+
+} // namespace Vercmp
+
+#endif // VERCMP_H